@@ -7,6 +7,9 @@
 #include <WiFi.h>
 #include <esp_now.h>
 #include <esp_wifi.h>
+// Wire format shared with the S3 Box (components/aigis_proto, install as an Arduino library)
+#include <aigis_proto.h>
+#include <aigis_node.h>
 
 //#define CAMERA_MODEL_ESP_EYE // Has PSRAM
 #define CAMERA_MODEL_AI_THINKER // Has PSRAM
@@ -66,22 +69,10 @@
 #define CONFIDENCE_THRESHOLD 0.60  // 70% confidence required to trigger
 
 // --- ESP-NOW Configuration ---
-// MAC ADDRESS OF ESP32-S3-BOX-3
-uint8_t box3MacAddress[] = {0xB4, 0x3A, 0x45, 0xF3, 0x9E, 0x50};
+// The S3 Box 3 address is learned by pairing (aigis_node) and kept in flash
 
-// Structure to SEND data (Recognized Name)
-typedef struct struct_message_send {
-    char name[32];
-} struct_message_send;
-
-// Structure to RECEIVE data (Door Command)
-typedef struct struct_message_recv {
-    char command[16]; 
-} struct_message_recv;
-
-struct_message_send sendData;
-struct_message_recv recvData;
-esp_now_peer_info_t peerInfo;
+int32_t lastSeq = -1; // Seq of the last command applied; a retransmission is only re-acked
+uint16_t sendSeq = 0;
 
 /* Private variables ------------------------------------------------------- */
 static bool debug_nn = false;
@@ -130,21 +121,32 @@ void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
 }
 
 void OnDataRecv(const esp_now_recv_info_t * esp_now_info, const uint8_t *incomingData, int len) {
-    int copyLen = len;
-    if (copyLen > sizeof(recvData)) {
-        copyLen = sizeof(recvData);
+    // Only sealed frames from the paired S3 Box get through; spoofed unlocks are dropped here
+    uint8_t buf[AIGIS_PROTO_MAX_FRAME];
+    aigis_msg_t msg;
+    if (!aigis_node_recv(esp_now_info->src_addr, incomingData, len, buf, &msg) || msg.type != AIGIS_MSG_DOOR) {
+        return;
+    }
+
+    // ACK duplicates too: the first ACK may be the frame that got lost
+    if (msg.flags & AIGIS_FLAG_ACK_REQ) {
+        uint8_t ack[AIGIS_PROTO_HDR_LEN + AIGIS_SEAL_OVERHEAD];
+        aigis_node_send(ack, aigis_encode_ack(ack, sizeof(ack), msg.seq), sizeof(ack));
+    }
+    if (msg.seq == lastSeq) {
+        Serial.println("Duplicate command ignored");
+        return;
     }
-    
-    memset(&recvData, 0, sizeof(recvData));   
-    memcpy(&recvData, incomingData, copyLen); 
+    lastSeq = msg.seq;
 
-    Serial.printf("\n[Command Received]: %s\n", recvData.command);
+    uint8_t action = aigis_get_u8(&msg, AIGIS_TAG_DOOR_ACTION, AIGIS_DOOR_LOCK);
+    Serial.printf("\n[Command Received]: %s\n", action == AIGIS_DOOR_UNLOCK ? "unlock" : "lock");
 
-    if (strcmp(recvData.command, "unlock") == 0) {
+    if (action == AIGIS_DOOR_UNLOCK) {
         digitalWrite(RELAY_PIN, HIGH); 
         Serial.println("Action: Door Unlocked!");
     }
-    else if (strcmp(recvData.command, "lock") == 0) {
+    else {
         digitalWrite(RELAY_PIN, LOW); 
         Serial.println("Action: Door Locked!");
     }
@@ -182,17 +184,8 @@ void setup()
     esp_now_register_send_cb(OnDataSent);
     esp_now_register_recv_cb(OnDataRecv);
 
-    // Register S3 Box 3 as a Peer
-    memset(&peerInfo, 0, sizeof(peerInfo)); 
-    memcpy(peerInfo.peer_addr, box3MacAddress, 6);
-    peerInfo.channel = 11;  
-    peerInfo.encrypt = false;
-    peerInfo.ifidx = WIFI_IF_STA; 
-
-    if (esp_now_add_peer(&peerInfo) != ESP_OK){
-        Serial.println("Failed to add S3 Box 3 as peer");
-        return;
-    }
+    // Find the S3 Box 3: broadcasts HELLO until it answers (open its pairing window)
+    aigis_node_begin(AIGIS_ROLE_DOOR);
 
     if (ei_camera_init() == false) {
         ei_printf("Failed to initialize Camera!\r\n");
@@ -208,6 +201,8 @@ void setup()
 */
 void loop()
 {
+    aigis_node_loop();
+
     if (digitalRead(PIR_PIN) == HIGH) {
         Serial.println("\nMotion Detected! Capturing frame...");
 
@@ -272,8 +267,11 @@ void loop()
                 
                 Serial.printf("Authorized Person Identified: %s. Sending to S3 Box 3...\n", best_label);
                 
-                strcpy(sendData.name, best_label);
-                esp_now_send(box3MacAddress, (uint8_t *) &sendData, sizeof(sendData));
+                uint8_t frame[AIGIS_PROTO_MAX_FRAME];
+                size_t frameLen = aigis_encode_visitor(frame, sizeof(frame), 0, ++sendSeq, best_label);
+                if (aigis_node_send(frame, frameLen, sizeof(frame)) == ESP_ERR_ESPNOW_NOT_FOUND) {
+                    Serial.println("Not paired with the S3 Box 3 yet");
+                }
                 
                 delay(5000); 
             } else {
@@ -3,23 +3,51 @@
 #include <Adafruit_Sensor.h>
 #include <WiFi.h>
 #include <esp_now.h>
+// Wire format shared with the S3 Box (components/aigis_proto, install as an Arduino library)
+#include <aigis_proto.h>
+#include <aigis_node.h>
 #include "MAX30105.h" 
-#include "spo2_algorithm.h" 
+#include "fall_detector.h"
+#include "vitals_estimator.h"
+#include "sms_alert.h"
 
 // --- PIN DEFINITIONS FOR XIAO ESP32-C3 ---
 #define I2C_SDA_PIN D7 // GPIO 20
 #define I2C_SCL_PIN D6 // GPIO 21
 #define BUZZER_PIN  D5 // GPIO 8
+#define MPU_INT_PIN D3 // GPIO 5, MPU6050 INT; without it the FIFO is still drained on the burst timer
 
 // --- I2C ADDRESSES ---
 #define MPU_ADDR 0x68
 #define MAX_ADDR 0x57
 
+// --- MPU6050 REGISTERS (FIFO, not covered by the Adafruit driver) ---
+#define MPU_REG_FIFO_EN      0x23
+#define MPU_REG_INT_ENABLE   0x38
+#define MPU_REG_INT_STATUS   0x3A
+#define MPU_REG_USER_CTRL    0x6A
+#define MPU_REG_FIFO_COUNT_H 0x72
+#define MPU_REG_FIFO_R_W     0x74
+#define MPU_FIFO_ACCEL       0x08 // FIFO_EN: accelerometer X, Y, Z, 6 bytes per sample
+#define MPU_USER_FIFO_EN     0x40
+#define MPU_USER_FIFO_RESET  0x04
+#define MPU_INT_FIFO_OFLOW   0x10
+
+// --- MAX30102 REGISTERS (FIFO) ---
+#define MAX_REG_FIFO_WR_PTR  0x04
+#define MAX_REG_OVF_COUNTER  0x05
+#define MAX_REG_FIFO_RD_PTR  0x06
+#define MAX_REG_FIFO_DATA    0x07
+#define MAX_FIFO_DEPTH       32
+
 // --- WIFI & SMS CONFIGURATION ---
 const char* ssid = "xxxxxx";           // Replace with your Wi-Fi Name
 const char* password = "xxxxxxx";   // Replace with your Wi-Fi Password
 
 // Circuit Digest API Details
+// To test without sending real SMS, run Code_files/sms_test_server.py on a PC and put its address here
+const char* smsHost = "www.circuitdigest.cloud";
+const uint16_t smsPort = 80;
 const char* apiKey = "xxxxxx";           // Replace with your API key
 const char* templateID = "101";                // Using Template 101: "Your {#var#} is currently at {#var#}."
 const char* mobileNumber = "xxxxxxx";     // Replace with recipient number (include Country Code!)
@@ -27,46 +55,63 @@ const char* var1 = "HEALTH BAND";              // Custom variable 1
 const char* var2 = "FALL DETECTED";            // Custom variable 2
 
 // --- CONFIGURATION ---
-const float FALL_THRESHOLD = 25.0; 
+// Fall detection: free fall, impact, then lying still (thresholds in FALL_DETECTOR_DEFAULT_CONFIG)
+const uint16_t ACCEL_RATE_HZ = 100;            // MPU6050 output rate: 1 kHz / (1 + divisor) with the DLPF on
+const uint16_t ACCEL_LSB_PER_G = 4096;         // +-8 g range
+// Print every raw sample as "x,y,z" to record a trace for host_test/test_fall_detector.c
+const bool ACCEL_TRACE_ENABLED = false;
+// The sensor buffers samples in its FIFO (1024 bytes, 1.7 s at 100 Hz); the C3 sleeps and drains it
+// every FIFO_BURST_MS, or at once when the motion interrupt fires
+const uint16_t FIFO_BURST_MS = 250;
+const uint8_t FIFO_READ_SAMPLES = 40;          // Samples per I2C read; needs a 240-byte Wire buffer
+const uint8_t MOTION_THRESHOLD = 100;          // Wake-up jolt, 2 mg per count
+const uint16_t PULSE_RATE_HZ = 25;            // MAX30102 at 100 Hz with 4-sample averaging; 32-sample FIFO lasts 1.28 s
 const int HR_HIGH_LIMIT = 150;
 const int HR_LOW_LIMIT = 45;
 const int SPO2_LOW_LIMIT = 85;
 
+// Telemetry: one sample every TELEMETRY_PERIOD_MS, TELEMETRY_BATCH samples per frame
+const bool TELEMETRY_ENABLED = true;
+const uint16_t TELEMETRY_PERIOD_MS = 100;
+const uint8_t TELEMETRY_BATCH = 20;            // Up to AIGIS_TELEMETRY_MAX; 20 x 100 ms = one frame every 2 s
+
 // --- OBJECTS ---
 Adafruit_MPU6050 mpu;
 MAX30105 particleSensor;
+fall_detector_t fallDetector;
+vitals_estimator_t vitals;
+bool pulseSensorFound = false;
+TaskHandle_t loopTaskHandle = NULL;
 
 // --- ESP-NOW VARIABLES ---
-uint8_t broadcastAddress[] = {0xB4, 0x3A, 0x45, 0xF3, 0x9E, 0x50}; // b4:3a:45:f3:9e:50
-
-
-typedef struct struct_message {
-  bool fallDetected;
-  bool healthAlarm;
-  float heartRate;
-  int spo2;
-} struct_message;
-
-struct_message myData;
-esp_now_peer_info_t peerInfo;
+// The S3 Box address is learned by pairing (aigis_node) and kept in flash
+aigis_health_t myData;
+uint16_t sendSeq = 0;
+aigis_telemetry_t telemetry;
+uint16_t telemetrySkip = 0;
 
 // --- HEALTH VARIABLES ---
-uint32_t irBuffer[100]; 
-uint32_t redBuffer[100];  
-int32_t bufferLength = 100; 
-int32_t spo2; 
-int8_t validSPO2; 
-int32_t heartRate; 
-int8_t validHeartRate; 
+uint8_t currentHR = 0;     // Latest valid readings, 0 until measured
+uint8_t currentSpO2 = 0;
 
 // Buzzer timing
 unsigned long buzzerStartTime = 0;
 bool isBuzzing = false;
 
 // Function declarations
-void sendSMS();
 void triggerAlarm();
 void handleBuzzer();
+void recordTelemetry();
+void setupAccelFifo();
+bool drainAccelFifo();
+void drainPulseFifo();
+
+// Only pairing frames come from the S3 Box
+void OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len) {
+  uint8_t buf[AIGIS_PROTO_MAX_FRAME];
+  aigis_msg_t msg;
+  aigis_node_recv(info->src_addr, incomingData, len, buf, &msg);
+}
 
 void setup() {
   Serial.begin(115200);
@@ -75,7 +120,8 @@ void setup() {
   pinMode(BUZZER_PIN, OUTPUT);
   digitalWrite(BUZZER_PIN, LOW);
 
-  // 2. Init I2C
+  // 2. Init I2C (buffer sized for FIFO bursts)
+  Wire.setBufferSize(256);
   Wire.begin(I2C_SDA_PIN, I2C_SCL_PIN);
 
   // 3. Init MPU6050
@@ -88,11 +134,17 @@ void setup() {
   mpu.setAccelerometerRange(MPU6050_RANGE_8_G);
   mpu.setGyroRange(MPU6050_RANGE_500_DEG);
   mpu.setFilterBandwidth(MPU6050_BAND_21_HZ);
+  mpu.setSampleRateDivisor(1000 / ACCEL_RATE_HZ - 1);
+  setupAccelFifo();
+  fall_detector_config_t fallConfig = FALL_DETECTOR_DEFAULT_CONFIG();
+  fall_detector_init(&fallDetector, &fallConfig, ACCEL_RATE_HZ, ACCEL_LSB_PER_G);
 
-  // 4. Init MAX30102 (Logic commented out in loop)
+  // 4. Init MAX30102 (heart rate and SpO2 read 0 without it)
+  vitals_estimator_init(&vitals, PULSE_RATE_HZ);
   if (!particleSensor.begin(Wire, 400000, MAX_ADDR)) { 
     Serial.println("MAX30102 not found. (Ignored for Fall Test)");
   } else {
+    pulseSensorFound = true;
     Serial.println("MAX30102 Found!");
     byte ledBrightness = 60; 
     byte sampleAverage = 4; 
@@ -115,126 +167,228 @@ void setup() {
   Serial.print("Operating on Wi-Fi Channel: ");
   Serial.println(WiFi.channel()); // Take note of this channel for your Receiver!
 
+  // SMS alerts go out from their own task, so a slow server never holds up the sensors
+  sms_alert_config_t smsConfig = {
+    .host = smsHost,
+    .port = smsPort,
+    .api_key = apiKey,
+    .template_id = templateID,
+    .mobile = mobileNumber,
+  };
+  if (!sms_alert_begin(&smsConfig)) {
+    Serial.println("SMS alerts unavailable!");
+  }
+
   // 6. Init ESP-NOW (It will inherit the Wi-Fi router's channel)
   if (esp_now_init() != ESP_OK) {
     Serial.println("Error initializing ESP-NOW");
     return;
   }
-  
-  memcpy(peerInfo.peer_addr, broadcastAddress, 6);
-  peerInfo.channel = 0;  // 0 means it uses the current active channel (the router's channel)
-  peerInfo.encrypt = false;
-  
-  if (esp_now_add_peer(&peerInfo) != ESP_OK){
-    Serial.println("Failed to add peer");
-    return;
-  }
+  esp_now_register_recv_cb(OnDataRecv);
+
+  // 7. Find the S3 Box: broadcasts HELLO until it answers (open its pairing window)
+  aigis_node_begin(AIGIS_ROLE_HEALTH);
 }
 
 void loop() {
+  aigis_node_loop();
+
   // --- FALL DETECTION ---
-  sensors_event_t a, g, temp;
-  mpu.getEvent(&a, &g, &temp);
+  // Sleep until a burst is due or the motion interrupt fires; every buffered sample goes through the detector
+  ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(FIFO_BURST_MS));
+  // --- HEALTH MONITORING ---
+  // Heart rate and SpO2 follow each beat; read first so telemetry carries the latest values
+  drainPulseFifo();
+  bool isFallen = drainAccelFifo();
 
-  float accel_magnitude = sqrt(pow(a.acceleration.x, 2) + pow(a.acceleration.y, 2) + pow(a.acceleration.z, 2));
-  
-  bool isFallen = false;
-  if (accel_magnitude > FALL_THRESHOLD) {
-    isFallen = true;
+  if (isFallen) {
     Serial.println("!!! FALL DETECTED !!!");
     triggerAlarm();
   }
 
-  // --- HEALTH MONITORING (COMMENTED OUT FOR TESTING) ---
-  /*
-  // [Health code is temporarily bypassed for testing fall detection]
-  */
-
   // --- DATA TRANSMISSION (ESP-NOW + SMS) ---
   if (isFallen) {
     // 1. Send ESP-NOW Message
-    myData.fallDetected = isFallen;
-    myData.healthAlarm = false; 
-    myData.heartRate = 0.0;     
-    myData.spo2 = 0;            
+    myData.fall = isFallen;
+    myData.alarm = false; 
+    myData.heart_rate = currentHR;
+    myData.spo2 = currentSpO2;
 
-    esp_err_t result = esp_now_send(broadcastAddress, (uint8_t *) &myData, sizeof(myData));
+    uint8_t frame[AIGIS_PROTO_MAX_FRAME];
+    size_t frameLen = aigis_encode_health(frame, sizeof(frame), 0, ++sendSeq, &myData);
+    esp_err_t result = aigis_node_send(frame, frameLen, sizeof(frame));
     if (result == ESP_OK) {
       Serial.println("ESP-NOW: Fall Alert Broadcasted!");
     } else {
-      Serial.println("ESP-NOW: Error sending data");
+      Serial.println(result == ESP_ERR_ESPNOW_NOT_FOUND ? "ESP-NOW: Not paired with the S3 Box yet" : "ESP-NOW: Error sending data");
     }
 
-    // 2. Send SMS Alert via HTTP POST
+    // 2. Queue the SMS Alert; the HTTP POST happens in the background
     Serial.println("Triggering SMS Alert...");
-    sendSMS();
-    
-    // Delay to stop flooding. Fall alerts shouldn't trigger multiple times a second.
-    delay(3000); 
+    if (!sms_alert_post(var1, var2)) {
+      Serial.println("SMS queue full, alert dropped!");
+    }
+    // No hold-off needed: the detector reports each fall once and needs a new free fall to fire again
   }
   
   handleBuzzer();
-  delay(10); 
 }
 
-// --- SMS SENDING FUNCTION ---
-void sendSMS() {
-  if (WiFi.status() == WL_CONNECTED) {
-    WiFiClient client;
-    String apiUrl = "/api/v1/send_sms?ID=" + String(templateID);
-    
-    Serial.print("Connecting to SMS server...");
-    if (client.connect("www.circuitdigest.cloud", 80)) {
-      Serial.println("connected!");
-      
-      // Create JSON payload
-      String payload = "{\"mobiles\":\"" + String(mobileNumber) + "\",\"var1\":\"" + String(var1) + "\",\"var2\":\"" + String(var2) + "\"}";
-      
-      // Send HTTP POST request headers
-      client.println("POST " + apiUrl + " HTTP/1.1");
-      client.println("Host: www.circuitdigest.cloud");
-      client.println("Authorization: " + String(apiKey));
-      client.println("Content-Type: application/json");
-      client.println("Content-Length: " + String(payload.length()));
-      client.println(); // Empty line separates headers from payload
-      
-      // Send the JSON payload
-      client.println(payload);
-      
-      // Wait briefly for response
-      int timeout = millis();
-      while (client.available() == 0) {
-        if (millis() - timeout > 5000) {
-          Serial.println(">>> Client Timeout!");
-          client.stop();
-          return;
-        }
-      }
+// --- ACCELEROMETER FIFO ---
+bool mpuWrite(uint8_t reg, uint8_t value) {
+  Wire.beginTransmission(MPU_ADDR);
+  Wire.write(reg);
+  Wire.write(value);
+  return Wire.endTransmission() == 0;
+}
 
-      // Read HTTP response code to confirm success
-      int responseCode = -1;
-      while (client.available()) {
-        String line = client.readStringUntil('\n');
-        if (line.startsWith("HTTP/")) {
-          responseCode = line.substring(9, 12).toInt();
-          break; // We only care about the response code
-        }
+bool mpuRead(uint8_t reg, uint8_t *buf, size_t len) {
+  Wire.beginTransmission(MPU_ADDR);
+  Wire.write(reg);
+  if (Wire.endTransmission(false) != 0 || Wire.requestFrom((uint16_t)MPU_ADDR, len) != len) {
+    return false;
+  }
+  for (size_t i = 0; i < len; i++) {
+    buf[i] = Wire.read();
+  }
+  return true;
+}
+
+void IRAM_ATTR onMpuInterrupt() {
+  BaseType_t woken = pdFALSE;
+  vTaskNotifyGiveFromISR(loopTaskHandle, &woken);
+  portYIELD_FROM_ISR(woken);
+}
+
+// Accelerometer samples only (no gyro or temperature) into the FIFO at ACCEL_RATE_HZ. The motion
+// interrupt wakes the loop on a jolt; the data-ready interrupt is left off, it would wake the C3
+// for every sample and defeat the burst reads. The MPU6050 has no FIFO watermark interrupt.
+void setupAccelFifo() {
+  loopTaskHandle = xTaskGetCurrentTaskHandle();
+  mpu.setHighPassFilter(MPU6050_HIGHPASS_0_63_HZ);
+  mpu.setMotionDetectionThreshold(MOTION_THRESHOLD);
+  mpu.setMotionDetectionDuration(1);
+  mpu.setInterruptPinLatch(false);
+  mpu.setInterruptPinPolarity(false); // Active high
+  mpu.setMotionInterrupt(true);
+  uint8_t intEnable = 0;
+  mpuRead(MPU_REG_INT_ENABLE, &intEnable, 1);
+  mpuWrite(MPU_REG_INT_ENABLE, intEnable | MPU_INT_FIFO_OFLOW);
+
+  mpuWrite(MPU_REG_FIFO_EN, MPU_FIFO_ACCEL);
+  mpuWrite(MPU_REG_USER_CTRL, MPU_USER_FIFO_RESET);
+  mpuWrite(MPU_REG_USER_CTRL, MPU_USER_FIFO_EN);
+
+  pinMode(MPU_INT_PIN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(MPU_INT_PIN), onMpuInterrupt, RISING);
+}
+
+// Read every buffered sample in bursts of FIFO_READ_SAMPLES, one I2C transaction each
+bool drainAccelFifo() {
+  uint8_t status, count[2];
+  if (!mpuRead(MPU_REG_INT_STATUS, &status, 1) || !mpuRead(MPU_REG_FIFO_COUNT_H, count, 2)) {
+    return false;
+  }
+  if (status & MPU_INT_FIFO_OFLOW) {
+    // A full FIFO drops bytes, so sample boundaries are lost: start over
+    Serial.println("MPU6050 FIFO overflow, samples lost");
+    mpuWrite(MPU_REG_USER_CTRL, MPU_USER_FIFO_RESET | MPU_USER_FIFO_EN);
+    return false;
+  }
+
+  bool fallen = false;
+  uint16_t samples = ((count[0] << 8) | count[1]) / 6;
+  uint8_t raw[FIFO_READ_SAMPLES * 6];
+  while (samples) {
+    const uint16_t n = (samples < FIFO_READ_SAMPLES) ? samples : FIFO_READ_SAMPLES;
+    if (!mpuRead(MPU_REG_FIFO_R_W, raw, n * 6)) {
+      break;
+    }
+    for (uint16_t i = 0; i < n; i++) {
+      const uint8_t *s = &raw[i * 6];
+      const int16_t x = (s[0] << 8) | s[1];
+      const int16_t y = (s[2] << 8) | s[3];
+      const int16_t z = (s[4] << 8) | s[5];
+      if (ACCEL_TRACE_ENABLED) {
+        Serial.printf("%d,%d,%d\n", x, y, z);
       }
-      
-      if (responseCode == 200) {
-        Serial.println(">>> SMS SENT SUCCESSFULLY! <<<");
-      } else {
-        Serial.print(">>> Failed to send SMS. HTTP Code: ");
-        Serial.println(responseCode);
+      if (fall_detector_update(&fallDetector, x, y, z)) {
+        fallen = true;
       }
-      
-      client.stop();
-    } else {
-      Serial.println("Connection to SMS server failed!");
+      recordTelemetry();
     }
-  } else {
-    Serial.println("Cannot send SMS: Wi-Fi disconnected!");
+    samples -= n;
+  }
+  return fallen;
+}
+
+// --- PULSE OXIMETER FIFO ---
+// Read every buffered red/IR pair in one transaction; the SparkFun check() keeps only 4 samples
+void drainPulseFifo() {
+  if (!pulseSensorFound) {
+    return;
+  }
+  uint8_t ptr[3], raw[MAX_FIFO_DEPTH * 6];
+  Wire.beginTransmission(MAX_ADDR);
+  Wire.write(MAX_REG_FIFO_WR_PTR);
+  if (Wire.endTransmission(false) != 0 || Wire.requestFrom((uint16_t)MAX_ADDR, (size_t)3) != 3) {
+    return;
+  }
+  for (int i = 0; i < 3; i++) {
+    ptr[i] = Wire.read();
+  }
+  if (ptr[1]) {
+    Serial.println("MAX30102 FIFO overflow, samples lost");
+  }
+  const size_t samples = (ptr[1] ? MAX_FIFO_DEPTH : (ptr[0] - ptr[2]) & (MAX_FIFO_DEPTH - 1));
+  if (!samples) {
+    return;
+  }
+
+  Wire.beginTransmission(MAX_ADDR);
+  Wire.write(MAX_REG_FIFO_DATA);
+  if (Wire.endTransmission(false) != 0 || Wire.requestFrom((uint16_t)MAX_ADDR, samples * 6) != samples * 6) {
+    return;
+  }
+  for (size_t i = 0; i < samples * 6; i++) {
+    raw[i] = Wire.read();
+  }
+  for (size_t i = 0; i < samples; i++) {
+    // LED mode 2: red then IR, 18 bits each
+    const uint8_t *s = &raw[i * 6];
+    const uint32_t red = (((uint32_t)s[0] << 16) | (s[1] << 8) | s[2]) & 0x3FFFF;
+    const uint32_t ir = (((uint32_t)s[3] << 16) | (s[4] << 8) | s[5]) & 0x3FFFF;
+    vitals_estimator_update(&vitals, red, ir);
+  }
+  currentHR = vitals.heart_rate;
+  currentSpO2 = vitals.spo2;
+}
+
+// --- TELEMETRY ---
+// Called for every accelerometer sample; keeps one per TELEMETRY_PERIOD_MS, timed by the sensor clock,
+// and sends a full batch in one frame instead of one frame per reading. The magnitude takes an integer
+// square root, so it is worked out only for the samples kept
+void recordTelemetry() {
+  if (!TELEMETRY_ENABLED || ++telemetrySkip < TELEMETRY_PERIOD_MS * ACCEL_RATE_HZ / 1000) {
+    return;
+  }
+  telemetrySkip = 0;
+
+  aigis_vitals_t *sample = &telemetry.sample[telemetry.count++];
+  sample->accel_mg = fall_detector_last_mg(&fallDetector);
+  sample->heart_rate = currentHR;
+  sample->spo2 = currentSpO2;
+
+  if (telemetry.count < TELEMETRY_BATCH && telemetry.count < AIGIS_TELEMETRY_MAX) {
+    return;
   }
+  telemetry.period_ms = TELEMETRY_PERIOD_MS;
+  uint8_t frame[AIGIS_PROTO_MAX_FRAME];
+  size_t frameLen = aigis_encode_telemetry(frame, sizeof(frame), 0, ++sendSeq, &telemetry);
+  aigis_node_send(frame, frameLen, sizeof(frame));
+  // Sample numbers run on even if the frame is lost, so the hub can count the gap
+  telemetry.first += telemetry.count;
+  telemetry.count = 0;
 }
 
 void triggerAlarm() {
@@ -0,0 +1,106 @@
+/*
+ * Fall Detector: streaming free-fall -> impact -> stillness detector over raw accelerometer samples.
+ */
+
+#include "fall_detector.h"
+
+#include <string.h>
+
+static uint32_t mg_squared(uint16_t mg, uint16_t lsb_per_g)
+{
+    const uint32_t counts = (uint32_t)mg * lsb_per_g / 1000;
+    return counts * counts;
+}
+
+static uint16_t ms_to_samples(uint16_t ms, uint16_t rate_hz)
+{
+    const uint32_t n = ((uint32_t)ms * rate_hz + 999) / 1000;
+    return n ? n : 1;
+}
+
+void fall_detector_init(fall_detector_t *fd, const fall_detector_config_t *cfg, uint16_t rate_hz, uint16_t lsb_per_g)
+{
+    memset(fd, 0, sizeof(*fd));
+    fd->freefall2 = mg_squared(cfg->freefall_mg, lsb_per_g);
+    fd->impact2 = mg_squared(cfg->impact_mg, lsb_per_g);
+    fd->still_low2 = mg_squared(cfg->still_low_mg, lsb_per_g);
+    fd->still_high2 = mg_squared(cfg->still_high_mg, lsb_per_g);
+    fd->freefall_n = ms_to_samples(cfg->freefall_ms, rate_hz);
+    fd->impact_n = ms_to_samples(cfg->impact_window_ms, rate_hz);
+    fd->settle_n = ms_to_samples(cfg->settle_ms, rate_hz);
+    fd->still_n = ms_to_samples(cfg->still_ms, rate_hz);
+    fd->lsb_per_g = lsb_per_g;
+    fd->state = FALL_IDLE;
+}
+
+bool fall_detector_update(fall_detector_t *fd, int16_t x, int16_t y, int16_t z)
+{
+    /* Each square fits in 2^30, so the sum of three fits in a uint32_t */
+    const uint32_t mag2 = (uint32_t)((int32_t)x * x) + (uint32_t)((int32_t)y * y) + (uint32_t)((int32_t)z * z);
+    fd->last2 = mag2;
+
+    switch (fd->state) {
+    case FALL_IDLE:
+        /* A run of low samples, so a single glitch is no free fall */
+        fd->count = (mag2 < fd->freefall2) ? fd->count + 1 : 0;
+        if (fd->count >= fd->freefall_n) {
+            fd->state = FALL_FREEFALL;
+            fd->count = 0;
+        }
+        break;
+
+    case FALL_FREEFALL:
+        if (mag2 > fd->impact2) {
+            fd->state = FALL_IMPACT;
+            fd->count = 0;
+        } else if (mag2 < fd->freefall2) {
+            fd->count = 0;      /* Still falling; the window starts when the fall ends */
+        } else if (++fd->count > fd->impact_n) {
+            fd->state = FALL_IDLE;
+            fd->count = 0;
+        }
+        break;
+
+    case FALL_IMPACT:
+        if (++fd->count >= fd->settle_n) {
+            fd->state = FALL_STILL;
+            fd->count = 0;
+        }
+        break;
+
+    case FALL_STILL:
+        /* Any movement over the window means the wearer is up again, or never fell */
+        if (mag2 < fd->still_low2 || mag2 > fd->still_high2) {
+            fd->state = FALL_IDLE;
+            fd->count = 0;
+        } else if (++fd->count >= fd->still_n) {
+            fd->state = FALL_IDLE;
+            fd->count = 0;
+            return true;
+        }
+        break;
+    }
+    return false;
+}
+
+uint16_t fall_detector_last_mg(const fall_detector_t *fd)
+{
+    /* Bitwise integer square root */
+    uint32_t v = fd->last2;
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+    while (bit > v) {
+        bit >>= 2;
+    }
+    while (bit) {
+        if (v >= root + bit) {
+            v -= root + bit;
+            root = (root >> 1) + bit;
+        } else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    const uint32_t mg = root * 1000 / fd->lsb_per_g;
+    return (mg < UINT16_MAX) ? mg : UINT16_MAX;
+}
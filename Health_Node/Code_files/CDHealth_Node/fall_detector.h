@@ -0,0 +1,86 @@
+/*
+ * Fall Detector: streaming free-fall -> impact -> stillness detector over raw accelerometer samples.
+ *
+ * Integer only: every threshold is turned into a squared magnitude in sensor counts once,
+ * so a sample costs three multiplies and a few compares, with no sqrt or float. A fall is
+ * reported once, when a short free fall is followed by an impact and then by lying still;
+ * a jump or sitting down hard fails the stillness check and is ignored.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    FALL_IDLE,
+    FALL_FREEFALL,      /*!< Free fall seen, waiting for the impact */
+    FALL_IMPACT,        /*!< Impact seen, letting the body settle */
+    FALL_STILL,         /*!< Checking that the wearer stays down */
+} fall_state_t;
+
+typedef struct {
+    uint16_t freefall_mg;       /*!< Below this the sensor is falling */
+    uint16_t impact_mg;         /*!< Above this is an impact */
+    uint16_t still_low_mg;      /*!< Lying still keeps the magnitude between low and high */
+    uint16_t still_high_mg;
+    uint16_t freefall_ms;       /*!< Shortest free fall */
+    uint16_t impact_window_ms;  /*!< Longest time from the end of the free fall to the impact */
+    uint16_t settle_ms;         /*!< Ignored after the impact */
+    uint16_t still_ms;          /*!< Time to lie still before the fall is reported */
+} fall_detector_config_t;
+
+#define FALL_DETECTOR_DEFAULT_CONFIG() {    \
+    .freefall_mg = 500,                     \
+    .impact_mg = 2500,                      \
+    .still_low_mg = 750,                    \
+    .still_high_mg = 1250,                  \
+    .freefall_ms = 60,                      \
+    .impact_window_ms = 500,                \
+    .settle_ms = 500,                       \
+    .still_ms = 1500,                       \
+}
+
+typedef struct {
+    uint32_t freefall2;         /* Thresholds as squared magnitudes in counts */
+    uint32_t impact2;
+    uint32_t still_low2;
+    uint32_t still_high2;
+    uint16_t freefall_n;        /* Durations in samples */
+    uint16_t impact_n;
+    uint16_t settle_n;
+    uint16_t still_n;
+    uint16_t lsb_per_g;
+
+    fall_state_t state;
+    uint16_t count;             /* Samples spent in the current phase */
+    uint32_t last2;             /* Squared magnitude of the latest sample */
+} fall_detector_t;
+
+/**
+ * @brief Set up a detector.
+ *
+ * @param rate_hz Sample rate of the samples passed to fall_detector_update()
+ * @param lsb_per_g Sensor counts per g, e.g. 4096 for an MPU6050 at +-8 g
+ */
+void fall_detector_init(fall_detector_t *fd, const fall_detector_config_t *cfg, uint16_t rate_hz, uint16_t lsb_per_g);
+
+/**
+ * @brief Feed one raw sample.
+ *
+ * @return bool true once for each fall, when the stillness check completes
+ */
+bool fall_detector_update(fall_detector_t *fd, int16_t x, int16_t y, int16_t z);
+
+/**
+ * @brief Magnitude of the latest sample in mg, for telemetry; takes an integer square root.
+ */
+uint16_t fall_detector_last_mg(const fall_detector_t *fd);
+
+#ifdef __cplusplus
+}
+#endif
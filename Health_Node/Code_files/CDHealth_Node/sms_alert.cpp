@@ -0,0 +1,149 @@
+/*
+ * SMS Alert: sends SMS alerts through the Circuit Digest HTTP API from a task of its own.
+ */
+
+#include "sms_alert.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <Arduino.h>
+#include <WiFi.h>
+
+#define SMS_TASK_STACK          (4096)
+#define SMS_TASK_PRIO           (1)         /* Same as loop(); the task mostly waits on the network */
+#define SMS_MAX_TRIES           (5)
+#define SMS_BACKOFF_MIN_MS      (2000)
+#define SMS_BACKOFF_MAX_MS      (60000)
+#define SMS_CONNECT_TIMEOUT_MS  (5000)
+#define SMS_RESPONSE_TIMEOUT_MS (5000)
+#define SMS_PATH                "/api/v1/send_sms"
+
+typedef struct {
+    char var1[SMS_ALERT_VAR_MAX];
+    char var2[SMS_ALERT_VAR_MAX];
+} sms_alert_msg_t;
+
+static sms_alert_config_t s_cfg;
+static QueueHandle_t s_queue = NULL;
+
+/* Used only by the task */
+static char s_body[160];
+static char s_request[512];
+static char s_status[32];
+
+/* HTTP status code, or -1 when the server could not be reached or did not answer */
+static int sms_try_send(const sms_alert_msg_t *msg)
+{
+    if (WiFi.status() != WL_CONNECTED) {
+        return -1;
+    }
+    const int body_len = snprintf(s_body, sizeof(s_body), "{\"mobiles\":\"%s\",\"var1\":\"%s\",\"var2\":\"%s\"}",
+                                  s_cfg.mobile, msg->var1, msg->var2);
+    const int len = snprintf(s_request, sizeof(s_request),
+                             "POST " SMS_PATH "?ID=%s HTTP/1.1\r\n"
+                             "Host: %s\r\n"
+                             "Authorization: %s\r\n"
+                             "Content-Type: application/json\r\n"
+                             "Content-Length: %d\r\n"
+                             "Connection: close\r\n"
+                             "\r\n"
+                             "%s",
+                             s_cfg.template_id, s_cfg.host, s_cfg.api_key, body_len, s_body);
+    if (body_len >= (int)sizeof(s_body) || len >= (int)sizeof(s_request)) {
+        return 400;     /* Too long to send; retrying cannot help */
+    }
+
+    WiFiClient client;
+    if (!client.connect(s_cfg.host, s_cfg.port, SMS_CONNECT_TIMEOUT_MS)) {
+        return -1;
+    }
+    if (client.write((const uint8_t *)s_request, len) != (size_t)len) {
+        client.stop();
+        return -1;
+    }
+
+    /* Only the status line matters: "HTTP/1.1 200 OK" */
+    size_t n = 0;
+    const uint32_t start = millis();
+    while (millis() - start < SMS_RESPONSE_TIMEOUT_MS) {
+        const int c = client.available() ? client.read() : -1;
+        if (c < 0) {
+            if (!client.connected()) {
+                break;
+            }
+            vTaskDelay(pdMS_TO_TICKS(10));
+            continue;
+        }
+        if ('\n' == c || n == sizeof(s_status) - 1) {
+            break;
+        }
+        s_status[n++] = c;
+    }
+    s_status[n] = '\0';
+    client.stop();
+
+    int code = -1;
+    if (1 != sscanf(s_status, "HTTP/%*s %d", &code)) {
+        return -1;
+    }
+    return code;
+}
+
+static void sms_task(void *arg)
+{
+    sms_alert_msg_t msg;
+    while (xQueueReceive(s_queue, &msg, portMAX_DELAY)) {
+        uint32_t backoff = SMS_BACKOFF_MIN_MS;
+        for (int attempt = 1; attempt <= SMS_MAX_TRIES; attempt++) {
+            const int code = sms_try_send(&msg);
+            if (200 == code) {
+                Serial.println(">>> SMS SENT SUCCESSFULLY! <<<");
+                break;
+            }
+            /* The request itself was refused; sending it again would get the same answer */
+            if (code >= 400 && code < 500 && code != 429) {
+                Serial.printf(">>> SMS rejected. HTTP Code: %d\n", code);
+                break;
+            }
+            if (attempt == SMS_MAX_TRIES) {
+                Serial.printf(">>> SMS failed after %d tries (last: %d), alert dropped\n", attempt, code);
+                break;
+            }
+            Serial.printf(">>> SMS try %d failed (%d), retrying in %lu ms\n", attempt, code, (unsigned long)backoff);
+            vTaskDelay(pdMS_TO_TICKS(backoff));
+            backoff = (backoff * 2 < SMS_BACKOFF_MAX_MS) ? backoff * 2 : SMS_BACKOFF_MAX_MS;
+        }
+    }
+    vTaskDelete(NULL);
+}
+
+bool sms_alert_begin(const sms_alert_config_t *cfg)
+{
+    if (s_queue) {
+        return true;
+    }
+    s_cfg = *cfg;
+    s_queue = xQueueCreate(SMS_ALERT_QUEUE_LEN, sizeof(sms_alert_msg_t));
+    if (!s_queue) {
+        return false;
+    }
+    if (pdPASS != xTaskCreate(sms_task, "sms_alert", SMS_TASK_STACK, NULL, SMS_TASK_PRIO, NULL)) {
+        vQueueDelete(s_queue);
+        s_queue = NULL;
+        return false;
+    }
+    return true;
+}
+
+bool sms_alert_post(const char *var1, const char *var2)
+{
+    if (!s_queue) {
+        return false;
+    }
+    sms_alert_msg_t msg;
+    strncpy(msg.var1, var1, sizeof(msg.var1) - 1);
+    msg.var1[sizeof(msg.var1) - 1] = '\0';
+    strncpy(msg.var2, var2, sizeof(msg.var2) - 1);
+    msg.var2[sizeof(msg.var2) - 1] = '\0';
+    return pdTRUE == xQueueSend(s_queue, &msg, 0);
+}
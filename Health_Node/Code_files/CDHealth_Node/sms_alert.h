@@ -0,0 +1,48 @@
+/*
+ * SMS Alert: sends SMS alerts through the Circuit Digest HTTP API from a task of its own.
+ *
+ * sms_alert_post() copies the two template variables into a short queue and returns at
+ * once, so the sensor loop never waits on Wi-Fi or the server. The task sends one alert
+ * at a time from fixed buffers (no String), and retries a failed send with a doubling
+ * back-off; a rejected request (4xx other than 429) is not retried. The host and port are
+ * part of the configuration, so a local stand-in (Code_files/sms_test_server.py) can take
+ * the place of the real server while testing.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SMS_ALERT_QUEUE_LEN (4)     /* Alerts waiting; more are refused */
+#define SMS_ALERT_VAR_MAX   (32)    /* Per template variable, including the terminator */
+
+typedef struct {
+    const char *host;               /*!< Strings are used in place, so must stay valid */
+    uint16_t port;
+    const char *api_key;
+    const char *template_id;
+    const char *mobile;             /*!< Recipient, with country code */
+} sms_alert_config_t;
+
+/**
+ * @brief Start the sending task. Call once Wi-Fi is set up.
+ *
+ * @return bool false if the queue or the task could not be created
+ */
+bool sms_alert_begin(const sms_alert_config_t *cfg);
+
+/**
+ * @brief Queue an alert filling the template's two variables. Never blocks.
+ *
+ * @return bool false if the queue is full or sms_alert_begin() was not called
+ */
+bool sms_alert_post(const char *var1, const char *var2);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Vitals Estimator: streaming heart rate and SpO2 from MAX30102 red/IR samples.
+ */
+
+#include "vitals_estimator.h"
+
+#include <string.h>
+
+#define VITALS_MA_LEN       (4)     /* Smoothing length; a valley is reported this many samples late */
+#define VITALS_LEVEL_SHIFT  (5)     /* Threshold follows the smoothed signal over about 32 samples */
+#define VITALS_TH_MIN       (30)    /* Valley threshold clamp, as in the batch routine */
+#define VITALS_TH_MAX       (60)
+
+void vitals_estimator_init(vitals_estimator_t *ve, uint16_t rate_hz)
+{
+    memset(ve, 0, sizeof(*ve));
+    ve->rate_hz = rate_hz;
+    /* The batch routine keeps peaks 4 samples apart at 25 Hz, i.e. 160 ms */
+    ve->min_gap = (rate_hz * 4 + 24) / 25;
+    if (ve->min_gap < 1) {
+        ve->min_gap = 1;
+    }
+}
+
+static void vitals_drop_oldest(vitals_estimator_t *ve)
+{
+    ve->beats--;
+    memmove(&ve->valley_at[0], &ve->valley_at[1], ve->beats * sizeof(ve->valley_at[0]));
+    memmove(&ve->valley_ir[0], &ve->valley_ir[1], ve->beats * sizeof(ve->valley_ir[0]));
+    memmove(&ve->valley_red[0], &ve->valley_red[1], ve->beats * sizeof(ve->valley_red[0]));
+    memmove(&ve->ratio[0], &ve->ratio[1], ve->beats * sizeof(ve->ratio[0]));
+}
+
+/* Height of the peak over the line between the two valleys around it */
+static int32_t vitals_ac(uint32_t v0, uint32_t v1, uint32_t at0, uint32_t at1, uint32_t max, uint32_t max_at)
+{
+    const int32_t base = (int32_t)v0 + ((int32_t)v1 - (int32_t)v0) * (int32_t)(max_at - at0) / (int32_t)(at1 - at0);
+    return (int32_t)max - base;
+}
+
+static uint8_t vitals_spo2_from_ratio(int32_t r)
+{
+    /* Maxim calibration: SpO2 = -45.060 R^2 + 30.354 R + 94.845, with r = 100 R */
+    const int32_t x1000 = 94845 + 30354 * r / 100 - 45060 * r * r / 10000;
+    if (x1000 <= 0) {
+        return 0;
+    }
+    return (x1000 >= 99500) ? 100 : (x1000 + 500) / 1000;
+}
+
+static void vitals_publish(vitals_estimator_t *ve)
+{
+    ve->heart_rate = 0;
+    if (ve->beats >= 2) {
+        const uint32_t span = ve->valley_at[ve->beats - 1] - ve->valley_at[0];
+        const uint32_t bpm = ((uint32_t)ve->rate_hz * 60 * (ve->beats - 1) + span / 2) / span;
+        ve->heart_rate = (bpm <= UINT8_MAX) ? bpm : 0;
+    }
+
+    /* Median of the latest ratios, sorted by insertion; at most VITALS_RATIOS of them */
+    int32_t r[VITALS_RATIOS];
+    int n = 0;
+    for (int i = ve->beats - 1; i >= 0 && n < VITALS_RATIOS; i--) {
+        if (ve->ratio[i] < 0) {
+            continue;
+        }
+        int j = n++;
+        while (j > 0 && r[j - 1] > ve->ratio[i]) {
+            r[j] = r[j - 1];
+            j--;
+        }
+        r[j] = ve->ratio[i];
+    }
+    ve->spo2 = 0;
+    if (n) {
+        const int mid = n / 2;
+        const int32_t ratio = (mid > 1) ? (r[mid - 1] + r[mid]) / 2 : r[mid];
+        if (ratio > 2 && ratio < 184) {
+            ve->spo2 = vitals_spo2_from_ratio(ratio);
+        }
+    }
+}
+
+bool vitals_estimator_update(vitals_estimator_t *ve, uint32_t red, uint32_t ir)
+{
+    const uint32_t n = ve->n++;
+    const uint32_t slot = n % VITALS_WINDOW;
+    if (n >= VITALS_WINDOW) {
+        ve->ir_sum -= ve->ir[slot];
+        ve->red_sum -= ve->red[slot];
+    }
+    ve->ir[slot] = ir;
+    ve->red[slot] = red;
+    ve->ir_sum += ir;
+    ve->red_sum += red;
+
+    /* Beats older than the window no longer count */
+    bool changed = false;
+    while (ve->beats && n - ve->valley_at[0] >= VITALS_WINDOW) {
+        vitals_drop_oldest(ve);
+        changed = true;
+    }
+
+    const uint32_t filled = (n < VITALS_WINDOW) ? n + 1 : VITALS_WINDOW;
+    const uint32_t ir_dc = ve->ir_sum / filled;
+    if (ir_dc < VITALS_MIN_IR_DC) {
+        ve->beats = 0;
+        ve->heart_rate = 0;
+        ve->spo2 = 0;
+        return false;
+    }
+
+    /* Pulses dip the IR level, so the inverted AC peaks at each valley */
+    const int32_t ac = (int32_t)ir_dc - (int32_t)ir;
+    ve->ac_sum += ac - ve->ac[n % VITALS_MA_LEN];
+    ve->ac[n % VITALS_MA_LEN] = ac;
+    const int32_t s = ve->ac_sum / VITALS_MA_LEN;
+    const int32_t s1 = ve->smooth[1];
+    const int32_t s2 = ve->smooth[0];
+    ve->smooth[0] = s1;
+    ve->smooth[1] = s;
+    ve->level += (s - ve->level) / (1 << VITALS_LEVEL_SHIFT);
+    if (n < VITALS_MA_LEN + 1) {
+        return false;
+    }
+
+    /* The smoothed value before this one covers raw samples m .. m + 3, as in the batch routine */
+    const uint32_t m = n - VITALS_MA_LEN;
+    const uint32_t m_ir = ve->ir[m % VITALS_WINDOW];
+    const uint32_t m_red = ve->red[m % VITALS_WINDOW];
+    const int32_t th = (ve->level < VITALS_TH_MIN) ? VITALS_TH_MIN : (ve->level > VITALS_TH_MAX) ? VITALS_TH_MAX : ve->level;
+
+    bool beat = s1 > th && s1 > s2 && s1 >= s
+                && (!ve->beats || m - ve->valley_at[ve->beats - 1] >= ve->min_gap);
+    if (beat) {
+        int32_t ratio = -1;
+        if (ve->beats) {
+            const int last = ve->beats - 1;
+            const int32_t ac_ir = vitals_ac(ve->valley_ir[last], m_ir, ve->valley_at[last], m, ve->ir_max, ve->ir_max_at);
+            const int32_t ac_red = vitals_ac(ve->valley_red[last], m_red, ve->valley_at[last], m, ve->red_max, ve->red_max_at);
+            const int64_t nume = ((int64_t)ac_red * ve->ir_max) >> 7;
+            const int64_t denom = ((int64_t)ac_ir * ve->red_max) >> 7;
+            if (denom > 0 && nume != 0) {
+                ratio = (int32_t)(nume * 100 / denom);
+            }
+        }
+        if (ve->beats == VITALS_MAX_BEATS) {
+            vitals_drop_oldest(ve);
+        }
+        ve->valley_at[ve->beats] = m;
+        ve->valley_ir[ve->beats] = m_ir;
+        ve->valley_red[ve->beats] = m_red;
+        ve->ratio[ve->beats] = ratio;
+        ve->beats++;
+        ve->ir_max = ve->red_max = 0;
+        changed = true;
+    }
+
+    /* Track the peak of the beat in progress, kept aligned with the valleys */
+    if (m_ir > ve->ir_max) {
+        ve->ir_max = m_ir;
+        ve->ir_max_at = m;
+    }
+    if (m_red > ve->red_max) {
+        ve->red_max = m_red;
+        ve->red_max_at = m;
+    }
+
+    if (changed) {
+        vitals_publish(ve);
+    }
+    return beat;
+}
@@ -0,0 +1,69 @@
+/*
+ * Vitals Estimator: streaming heart rate and SpO2 from MAX30102 red/IR samples.
+ *
+ * Follows the Maxim reference (spo2_algorithm.h) over the same 4 s window, but one sample
+ * at a time: the DC levels are running sums over the window, the 4-point smoothing is a
+ * running sum, and beats are IR valleys found as the samples arrive. Each beat adds one
+ * red/IR ratio; heart rate is the mean beat interval in the window and SpO2 comes from the
+ * median of the latest ratios. A sample costs a few adds and compares, with no rescan of
+ * the window and no float.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VITALS_WINDOW       (100)   /* Samples, 4 s at 25 Hz like the batch routine */
+#define VITALS_MAX_BEATS    (16)    /* Beats kept in the window; 240 bpm over 4 s */
+#define VITALS_RATIOS       (5)     /* Latest beats in the SpO2 median */
+#define VITALS_MIN_IR_DC    (50000) /* Below this no finger is on the sensor */
+
+typedef struct {
+    uint16_t rate_hz;
+    uint16_t min_gap;                       /* Shortest beat interval in samples */
+
+    uint32_t ir[VITALS_WINDOW];             /* Raw samples, for the DC sums and the beat maxima */
+    uint32_t red[VITALS_WINDOW];
+    uint32_t ir_sum;
+    uint32_t red_sum;
+    uint32_t n;                             /* Samples seen */
+
+    int32_t ac[4];                          /* Inverted IR AC, for the 4-point smoothing */
+    int32_t ac_sum;
+    int32_t smooth[2];                      /* Previous two smoothed values */
+    int32_t level;                          /* Running mean of the smoothed signal, the valley threshold */
+
+    uint32_t ir_max, red_max;               /* Largest raw values since the last valley */
+    uint32_t ir_max_at, red_max_at;
+    uint32_t valley_at[VITALS_MAX_BEATS];   /* Sample numbers of the valleys in the window, oldest first */
+    uint32_t valley_ir[VITALS_MAX_BEATS];
+    uint32_t valley_red[VITALS_MAX_BEATS];
+    int32_t ratio[VITALS_MAX_BEATS];        /* Red/IR ratio x 100 of the beat ending at each valley, or -1 */
+    uint8_t beats;
+
+    uint8_t heart_rate;                     /* bpm, 0 until valid */
+    uint8_t spo2;                           /* %, 0 until valid */
+} vitals_estimator_t;
+
+/**
+ * @brief Set up an estimator.
+ *
+ * @param rate_hz Rate of the samples after the sensor's own averaging, e.g. 25 for 100 Hz with 4-sample averaging
+ */
+void vitals_estimator_init(vitals_estimator_t *ve, uint16_t rate_hz);
+
+/**
+ * @brief Feed one sample. heart_rate and spo2 are updated at each beat.
+ *
+ * @return bool true when a new beat was found
+ */
+bool vitals_estimator_update(vitals_estimator_t *ve, uint32_t red, uint32_t ir);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+"""
+Stand-in for the Circuit Digest SMS API, for testing the Health Node's alerts
+without sending real messages.
+
+Point smsHost / smsPort in CDHealth_Node.ino at the PC running this script.
+Every POST to /api/v1/send_sms is printed and answered with 200, except that
+
+    --fail N     answers the first N requests with 503, to exercise the retries
+    --delay S    waits S seconds before answering, to exercise the timeouts
+"""
+
+import argparse
+import json
+import time
+from http.server import BaseHTTPRequestHandler, HTTPServer
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--port', type=int, default=8080)
+    parser.add_argument('--fail', type=int, default=0, help='answer the first N requests with 503')
+    parser.add_argument('--delay', type=float, default=0, help='seconds to wait before answering')
+    args = parser.parse_args()
+    state = {'count': 0}
+
+    class Handler(BaseHTTPRequestHandler):
+        def do_POST(self):
+            body = self.rfile.read(int(self.headers.get('Content-Length', 0)))
+            state['count'] += 1
+            print(f"#{state['count']} {self.path} auth={self.headers.get('Authorization')} body={body.decode(errors='replace')}")
+            try:
+                json.loads(body)
+            except ValueError:
+                print('  body is not valid JSON')
+            if args.delay:
+                time.sleep(args.delay)
+            code = 503 if state['count'] <= args.fail else 200
+            self.send_response(code)
+            self.send_header('Content-Type', 'application/json')
+            self.end_headers()
+            self.wfile.write(b'{"status":"ok"}' if code == 200 else b'{"status":"busy"}')
+
+    print(f'SMS stand-in listening on port {args.port}')
+    HTTPServer(('', args.port), Handler).serve_forever()
+
+
+if __name__ == '__main__':
+    main()
@@ -2,24 +2,11 @@
 #include <WiFi.h>
 #include <esp_wifi.h> // <-- ADDED: Required to force the Wi-Fi Channel
 
-// --- AIGIS SR COMMAND DEFINITIONS ---
-typedef enum {
-    TURN_ON_LIGHT_ONE = 1,
-    TURN_OFF_LIGHT_ONE,
-    TURN_ON_SOCKET,
-    TURN_OFF_SOCKET,
-    TURN_ON_FAN_AT_LEVEL_ONE,
-    TURN_ON_FAN_AT_LEVEL_TWO,
-    TURN_ON_FAN_AT_LEVEL_THREE,
-    TURN_OFF_FAN
-} aigis_command_t;
-
-// ESP-NOW Data Structure
-typedef struct struct_message {
-  int command; 
-} struct_message;
-
-struct_message myData;
+// Wire format and command IDs shared with the S3 Box (components/aigis_proto, install as an Arduino library)
+#include <aigis_proto.h>
+#include <aigis_node.h>
+
+int32_t lastSeq = -1; // Seq of the last command applied; a retransmission is only re-acked
 
 // --- HARDWARE PIN DEFINITIONS ---
 // Touch Pins
@@ -76,14 +63,37 @@ void IRAM_ATTR onZeroCross() {
   }
 }
 
+// --- ESP-NOW ACK (the hub retransmits until it gets one) ---
+void sendAck(uint16_t seq) {
+  uint8_t ack[AIGIS_PROTO_HDR_LEN + AIGIS_SEAL_OVERHEAD];
+  aigis_node_send(ack, aigis_encode_ack(ack, sizeof(ack), seq), sizeof(ack));
+}
+
 // --- ESP-NOW CALLBACK (RECEIVING FROM AIGIS) ---
-void OnDataRecv(const uint8_t * mac, const uint8_t *incomingData, int len) {
-  memcpy(&myData, incomingData, sizeof(myData));
+void OnDataRecv(const esp_now_recv_info_t *info, const uint8_t *incomingData, int len) {
+  // Only sealed frames from the paired S3 Box get through
+  uint8_t buf[AIGIS_PROTO_MAX_FRAME];
+  aigis_msg_t msg;
+  if (!aigis_node_recv(info->src_addr, incomingData, len, buf, &msg) || msg.type != AIGIS_MSG_CONTROL) {
+    return;
+  }
+
+  // ACK duplicates too: the first ACK may be the frame that got lost
+  if (msg.flags & AIGIS_FLAG_ACK_REQ) {
+    sendAck(msg.seq);
+  }
+  if (msg.seq == lastSeq) {
+    Serial.println("Duplicate command ignored");
+    return;
+  }
+  lastSeq = msg.seq;
+
+  uint8_t command = aigis_get_u8(&msg, AIGIS_TAG_COMMAND, 0);
   Serial.print("Aigis Voice Command Received: "); 
-  Serial.println(myData.command);
+  Serial.println(command);
 
   // LOGIC
-  switch(myData.command) {
+  switch(command) {
     // Light Control
     case TURN_ON_LIGHT_ONE:
       lightState = true;
@@ -154,12 +164,17 @@ void setup() {
     Serial.println("ESP-NOW Init Failed");
     return;
   }
-  esp_now_register_recv_cb(esp_now_recv_cb_t(OnDataRecv));
+  esp_now_register_recv_cb(OnDataRecv);
+
+  // Announce to the S3 Box until it pairs this node (open its pairing window)
+  aigis_node_begin(AIGIS_ROLE_CONTROL);
 
   Serial.println("Aigis Smart Node Ready on Channel 11.");
 }
 
 void loop() {
+  aigis_node_loop();
+
   // Read Touch Sensors
   int tLight = touchRead(touchPinLight);   // Pin 4
   int tSocket = touchRead(touchPinSocket); // Pin 15
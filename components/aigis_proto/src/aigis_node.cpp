@@ -0,0 +1,238 @@
+/*
+ * Aigis Node: pairing and sealed links for the Arduino node sketches (not built into the hub).
+ */
+
+#ifdef ARDUINO
+
+#include "aigis_node.h"
+
+#include <string.h>
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp_now.h>
+#include <esp_wifi.h>
+
+#define NODE_HELLO_MIN_MS   (1000)
+#define NODE_HELLO_MAX_MS   (30000)
+#define NODE_CTR_BLOCK      (256)   /* Send counters reserved per flash write */
+#define NODE_CMD_LEN        (16)    /* Serial command line, terminator included */
+
+static const uint8_t s_broadcast[6] = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+
+static aigis_role_t s_role = AIGIS_ROLE_NONE;
+static uint8_t s_own[6];
+static uint8_t s_hub[6];
+static uint8_t s_key[AIGIS_KEY_LEN];
+static volatile bool s_paired = false;      /* s_hub and s_key valid; set last */
+static uint16_t s_seq = 0;
+static uint32_t s_hello_at = 0;
+static uint32_t s_hello_interval = NODE_HELLO_MIN_MS;
+static aigis_keypair_t s_kp;
+static bool s_kp_valid = false;
+
+/* Send counters come from a block saved ahead in flash, so a reboot never reuses one */
+static portMUX_TYPE s_ctr_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_tx_ctr = 0;
+static uint32_t s_tx_ctr_limit = 0;
+/* Last counter taken from the hub; saved by aigis_node_loop() */
+static volatile uint32_t s_rx_ctr = 0;
+static uint32_t s_rx_ctr_saved = 0;
+
+/* Written by the receive callback, applied by aigis_node_loop() */
+static uint8_t s_pair_mac[6];
+static uint8_t s_pair_pub[AIGIS_PUBKEY_LEN];
+static volatile bool s_pair_pending = false;
+
+static char s_cmd[NODE_CMD_LEN];
+static size_t s_cmd_len = 0;
+
+static void node_add_peer(const uint8_t *mac)
+{
+    if (esp_now_is_peer_exist(mac)) {
+        return;
+    }
+    esp_now_peer_info_t peer = {};
+    memcpy(peer.peer_addr, mac, 6);
+    peer.channel = 0;   /* Current channel */
+    peer.encrypt = false;
+    esp_now_add_peer(&peer);
+}
+
+static void node_ctr_reserve(void)
+{
+    Preferences prefs;
+    prefs.begin("aigis", false);
+    const bool saved = prefs.putUInt("txc", s_tx_ctr_limit + NODE_CTR_BLOCK);
+    prefs.end();
+    if (saved) {
+        portENTER_CRITICAL(&s_ctr_lock);
+        s_tx_ctr_limit += NODE_CTR_BLOCK;
+        portEXIT_CRITICAL(&s_ctr_lock);
+    }
+}
+
+bool aigis_node_begin(aigis_role_t role)
+{
+    s_role = role;
+    esp_wifi_get_mac(WIFI_IF_STA, s_own);
+    node_add_peer(s_broadcast);
+
+    Preferences prefs;
+    prefs.begin("aigis", false);
+    const bool paired = (sizeof(s_hub) == prefs.getBytes("hub", s_hub, sizeof(s_hub)))
+                        && (sizeof(s_key) == prefs.getBytes("key", s_key, sizeof(s_key)));
+    s_rx_ctr = s_rx_ctr_saved = prefs.getUInt("rxc", 0);
+    s_tx_ctr = s_tx_ctr_limit = prefs.getUInt("txc", 0);
+    prefs.end();
+    node_ctr_reserve();
+
+    if (paired) {
+        node_add_peer(s_hub);
+        Serial.printf("Aigis hub %02X:%02X:%02X:%02X:%02X:%02X (saved)\n",
+                      s_hub[0], s_hub[1], s_hub[2], s_hub[3], s_hub[4], s_hub[5]);
+    }
+    s_paired = paired;
+    s_hello_at = millis();
+    return paired;
+}
+
+bool aigis_node_recv(const uint8_t *mac, const uint8_t *data, int len, uint8_t *buf, aigis_msg_t *msg)
+{
+    if (len <= 0 || len > AIGIS_PROTO_MAX_FRAME) {
+        return false;
+    }
+    memcpy(buf, data, len);
+
+    if (aigis_is_sealed(buf, len)) {
+        uint32_t ctr;
+        if (!s_paired || memcmp(mac, s_hub, sizeof(s_hub))) {
+            return false;
+        }
+        const size_t plain_len = aigis_open(buf, len, s_key, s_hub, &ctr);
+        if (!plain_len || ctr <= s_rx_ctr) {
+            return false;
+        }
+        s_rx_ctr = ctr;
+        return aigis_msg_parse(buf, plain_len, msg);
+    }
+
+    /* Plain frames only pair an unpaired node; a paired one cannot be taken over */
+    aigis_tlv_t pub;
+    if (!s_paired && s_kp_valid && !s_pair_pending && aigis_msg_parse(buf, len, msg) && AIGIS_MSG_PAIR == msg->type
+            && aigis_tlv_find(msg, AIGIS_TAG_PUBKEY, &pub) && AIGIS_PUBKEY_LEN == pub.len) {
+        memcpy(s_pair_mac, mac, sizeof(s_pair_mac));
+        memcpy(s_pair_pub, pub.value, sizeof(s_pair_pub));
+        s_pair_pending = true;
+    }
+    return false;
+}
+
+esp_err_t aigis_node_send(uint8_t *frame, size_t len, size_t cap)
+{
+    if (!s_paired) {
+        return ESP_ERR_ESPNOW_NOT_FOUND;
+    }
+    uint32_t ctr = 0;
+    portENTER_CRITICAL(&s_ctr_lock);
+    if (s_tx_ctr < s_tx_ctr_limit) {
+        ctr = ++s_tx_ctr;
+    }
+    portEXIT_CRITICAL(&s_ctr_lock);
+
+    const size_t sealed = ctr ? aigis_seal(frame, len, cap, s_key, s_own, ctr) : 0;
+    return sealed ? esp_now_send(s_hub, frame, sealed) : ESP_ERR_INVALID_SIZE;
+}
+
+/* "unpair" typed on the serial monitor, e.g. after the hub forgot this node or was erased */
+static void node_serial_poll(void)
+{
+    while (Serial.available() > 0) {
+        const int c = Serial.read();
+        if ('\r' != c && '\n' != c) {
+            if (s_cmd_len < sizeof(s_cmd) - 1) {
+                s_cmd[s_cmd_len++] = c;
+            }
+            continue;
+        }
+        s_cmd[s_cmd_len] = '\0';
+        s_cmd_len = 0;
+        if (0 == strcmp(s_cmd, "unpair")) {
+            Serial.println("Forgetting the Aigis hub, pairing again");
+            aigis_node_unpair();
+        }
+    }
+}
+
+void aigis_node_loop(void)
+{
+    node_serial_poll();
+
+    if (s_pair_pending) {
+        uint8_t key[AIGIS_KEY_LEN];
+        if (aigis_key_derive(&s_kp, s_pair_pub, key)) {
+            memcpy(s_hub, s_pair_mac, sizeof(s_hub));
+            memcpy(s_key, key, sizeof(s_key));
+            s_rx_ctr = s_rx_ctr_saved = 0;
+            node_add_peer(s_hub);
+
+            Preferences prefs;
+            prefs.begin("aigis", false);
+            prefs.putBytes("hub", s_hub, sizeof(s_hub));
+            prefs.putBytes("key", s_key, sizeof(s_key));
+            prefs.putUInt("rxc", 0);
+            prefs.end();
+            s_paired = true;
+            Serial.printf("Paired with Aigis hub %02X:%02X:%02X:%02X:%02X:%02X\n",
+                          s_hub[0], s_hub[1], s_hub[2], s_hub[3], s_hub[4], s_hub[5]);
+        }
+        memset(key, 0, sizeof(key));
+        memset(&s_kp, 0, sizeof(s_kp));
+        s_kp_valid = false;
+        s_pair_pending = false;
+    }
+
+    if (s_paired) {
+        if (s_rx_ctr != s_rx_ctr_saved) {
+            s_rx_ctr_saved = s_rx_ctr;
+            Preferences prefs;
+            prefs.begin("aigis", false);
+            prefs.putUInt("rxc", s_rx_ctr_saved);
+            prefs.end();
+        }
+        if (s_tx_ctr_limit - s_tx_ctr < NODE_CTR_BLOCK / 2) {
+            node_ctr_reserve();
+        }
+        return;
+    }
+
+    if ((int32_t)(millis() - s_hello_at) < 0) {
+        return;
+    }
+    /* A new key pair per pairing attempt; X25519 takes a few ms, so not in the callback */
+    if (!s_kp_valid) {
+        s_kp_valid = aigis_keypair_gen(&s_kp);
+    }
+    if (s_kp_valid) {
+        uint8_t frame[AIGIS_PROTO_HDR_LEN + 3 + 2 + AIGIS_PUBKEY_LEN];
+        esp_now_send(s_broadcast, frame, aigis_encode_hello(frame, sizeof(frame), ++s_seq, s_role, s_kp.pub));
+    }
+    s_hello_at = millis() + s_hello_interval;
+    s_hello_interval = (s_hello_interval * 2 < NODE_HELLO_MAX_MS) ? s_hello_interval * 2 : NODE_HELLO_MAX_MS;
+}
+
+void aigis_node_unpair(void)
+{
+    if (s_paired) {
+        s_paired = false;
+        esp_now_del_peer(s_hub);
+    }
+    Preferences prefs;
+    prefs.begin("aigis", false);
+    prefs.remove("hub");
+    prefs.remove("key");
+    prefs.end();
+    s_hello_interval = NODE_HELLO_MIN_MS;
+    s_hello_at = millis();
+}
+
+#endif /* ARDUINO */
@@ -0,0 +1,60 @@
+/*
+ * Aigis Node: pairing and sealed links for the Arduino node sketches (not built into the hub).
+ *
+ * An unpaired node broadcasts AIGIS_MSG_HELLO with its role and a fresh public key until a
+ * hub answers with AIGIS_MSG_PAIR, backing off from 1 s to 30 s. The hub MAC, the link key
+ * and the counters are kept in Preferences, so a node pairs once. Every frame after pairing
+ * is sealed (aigis_secure.h); plain frames other than PAIR are dropped. The sketch passes
+ * received data through aigis_node_recv() and calls aigis_node_loop() from loop(); flash
+ * writes and peer changes happen in loop(), never in the Wi-Fi task. aigis_node_loop() also
+ * reads Serial: a line "unpair" calls aigis_node_unpair().
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <esp_err.h>
+#include "aigis_proto.h"
+#include "aigis_secure.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start pairing, unless a hub is saved. Call after esp_now_init().
+ *
+ * @return bool true if a hub is known from an earlier pairing
+ */
+bool aigis_node_begin(aigis_role_t role);
+
+/**
+ * @brief Take a received frame. Safe in the receive callback.
+ *
+ * @param buf AIGIS_PROTO_MAX_FRAME bytes; msg points into it
+ * @return bool true for a frame from the hub, authenticated and parsed into msg
+ */
+bool aigis_node_recv(const uint8_t *mac, const uint8_t *data, int len, uint8_t *buf, aigis_msg_t *msg);
+
+/**
+ * @brief Seal a frame built by the encoders in place and send it to the hub. Safe in the receive callback.
+ *
+ * @param cap Size of the frame buffer, at least len + AIGIS_SEAL_OVERHEAD
+ * @return esp_err_t ESP_ERR_ESPNOW_NOT_FOUND until paired, else the esp_now_send() result
+ */
+esp_err_t aigis_node_send(uint8_t *frame, size_t len, size_t cap);
+
+/**
+ * @brief Send HELLO when due, apply a received PAIR and save counters. Call from loop().
+ */
+void aigis_node_loop(void);
+
+/**
+ * @brief Forget the hub and start pairing again, e.g. after the hub was unpaired or erased.
+ */
+void aigis_node_unpair(void);
+
+#ifdef __cplusplus
+}
+#endif
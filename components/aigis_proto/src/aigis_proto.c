@@ -0,0 +1,235 @@
+/*
+ * Aigis Proto: the ESP-NOW wire format shared by the S3 Box hub and the node sketches.
+ */
+
+#include "aigis_proto.h"
+
+#include <string.h>
+
+void aigis_msg_begin(aigis_writer_t *w, uint8_t *buf, size_t cap, uint8_t type, uint8_t flags, uint16_t seq)
+{
+    w->buf = buf;
+    w->cap = cap;
+    w->len = AIGIS_PROTO_HDR_LEN;
+    w->overflow = cap < AIGIS_PROTO_HDR_LEN;
+    if (!w->overflow) {
+        buf[0] = (AIGIS_PROTO_VERSION << 4) | (flags & 0x0F);
+        buf[1] = type;
+        buf[2] = seq & 0xFF;
+        buf[3] = seq >> 8;
+    }
+}
+
+void aigis_put(aigis_writer_t *w, uint8_t tag, const void *value, size_t len)
+{
+    if (w->overflow || len > UINT8_MAX || w->cap - w->len < 2 + len) {
+        w->overflow = true;
+        return;
+    }
+    w->buf[w->len++] = tag;
+    w->buf[w->len++] = len;
+    if (len) {
+        memcpy(w->buf + w->len, value, len);
+        w->len += len;
+    }
+}
+
+void aigis_put_u8(aigis_writer_t *w, uint8_t tag, uint8_t value)
+{
+    aigis_put(w, tag, &value, 1);
+}
+
+void aigis_put_u16(aigis_writer_t *w, uint8_t tag, uint16_t value)
+{
+    const uint8_t le[2] = { value & 0xFF, value >> 8 };
+    aigis_put(w, tag, le, sizeof(le));
+}
+
+size_t aigis_msg_end(aigis_writer_t *w)
+{
+    return w->overflow ? 0 : w->len;
+}
+
+bool aigis_msg_parse(const uint8_t *frame, size_t len, aigis_msg_t *msg)
+{
+    if (!frame || len < AIGIS_PROTO_HDR_LEN || len > AIGIS_PROTO_MAX_FRAME
+            || AIGIS_PROTO_VERSION != (frame[0] >> 4)) {
+        return false;
+    }
+    msg->flags = frame[0] & 0x0F;
+    msg->type = frame[1];
+    msg->seq = frame[2] | (frame[3] << 8);
+    msg->tlv = frame + AIGIS_PROTO_HDR_LEN;
+    msg->tlv_len = len - AIGIS_PROTO_HDR_LEN;
+
+    /* Walk the fields once here, so the accessors can trust every length */
+    size_t pos = 0;
+    while (pos < msg->tlv_len) {
+        if (msg->tlv_len - pos < 2 || msg->tlv_len - pos - 2 < msg->tlv[pos + 1]) {
+            return false;
+        }
+        pos += 2 + msg->tlv[pos + 1];
+    }
+    return true;
+}
+
+bool aigis_tlv_next(const aigis_msg_t *msg, size_t *pos, aigis_tlv_t *tlv)
+{
+    if (*pos >= msg->tlv_len) {
+        return false;
+    }
+    tlv->tag = msg->tlv[*pos];
+    tlv->len = msg->tlv[*pos + 1];
+    tlv->value = msg->tlv + *pos + 2;
+    *pos += 2 + tlv->len;
+    return true;
+}
+
+bool aigis_tlv_find(const aigis_msg_t *msg, uint8_t tag, aigis_tlv_t *tlv)
+{
+    size_t pos = 0;
+    while (aigis_tlv_next(msg, &pos, tlv)) {
+        if (tag == tlv->tag) {
+            return true;
+        }
+    }
+    return false;
+}
+
+uint8_t aigis_get_u8(const aigis_msg_t *msg, uint8_t tag, uint8_t def)
+{
+    aigis_tlv_t tlv;
+    if (!aigis_tlv_find(msg, tag, &tlv) || 1 != tlv.len) {
+        return def;
+    }
+    return tlv.value[0];
+}
+
+uint16_t aigis_get_u16(const aigis_msg_t *msg, uint8_t tag, uint16_t def)
+{
+    aigis_tlv_t tlv;
+    if (!aigis_tlv_find(msg, tag, &tlv) || 2 != tlv.len) {
+        return def;
+    }
+    return tlv.value[0] | (tlv.value[1] << 8);
+}
+
+size_t aigis_encode_ack(uint8_t *buf, size_t cap, uint16_t seq)
+{
+    aigis_writer_t w;
+    aigis_msg_begin(&w, buf, cap, AIGIS_MSG_ACK, 0, seq);
+    return aigis_msg_end(&w);
+}
+
+size_t aigis_encode_hello(uint8_t *buf, size_t cap, uint16_t seq, aigis_role_t role, const uint8_t *pubkey)
+{
+    aigis_writer_t w;
+    aigis_msg_begin(&w, buf, cap, AIGIS_MSG_HELLO, 0, seq);
+    aigis_put_u8(&w, AIGIS_TAG_ROLE, role);
+    aigis_put(&w, AIGIS_TAG_PUBKEY, pubkey, AIGIS_PUBKEY_LEN);
+    return aigis_msg_end(&w);
+}
+
+size_t aigis_encode_pair(uint8_t *buf, size_t cap, uint16_t seq, const uint8_t *pubkey)
+{
+    aigis_writer_t w;
+    aigis_msg_begin(&w, buf, cap, AIGIS_MSG_PAIR, 0, seq);
+    aigis_put(&w, AIGIS_TAG_PUBKEY, pubkey, AIGIS_PUBKEY_LEN);
+    return aigis_msg_end(&w);
+}
+
+size_t aigis_encode_control(uint8_t *buf, size_t cap, uint8_t flags, uint16_t seq, aigis_command_t command)
+{
+    aigis_writer_t w;
+    aigis_msg_begin(&w, buf, cap, AIGIS_MSG_CONTROL, flags, seq);
+    aigis_put_u8(&w, AIGIS_TAG_COMMAND, command);
+    return aigis_msg_end(&w);
+}
+
+size_t aigis_encode_door(uint8_t *buf, size_t cap, uint8_t flags, uint16_t seq, aigis_door_action_t action)
+{
+    aigis_writer_t w;
+    aigis_msg_begin(&w, buf, cap, AIGIS_MSG_DOOR, flags, seq);
+    aigis_put_u8(&w, AIGIS_TAG_DOOR_ACTION, action);
+    return aigis_msg_end(&w);
+}
+
+size_t aigis_encode_visitor(uint8_t *buf, size_t cap, uint8_t flags, uint16_t seq, const char *name)
+{
+    aigis_writer_t w;
+    size_t len = strlen(name);
+    aigis_msg_begin(&w, buf, cap, AIGIS_MSG_VISITOR, flags, seq);
+    aigis_put(&w, AIGIS_TAG_NAME, name, (len > AIGIS_NAME_MAX) ? AIGIS_NAME_MAX : len);
+    return aigis_msg_end(&w);
+}
+
+size_t aigis_encode_health(uint8_t *buf, size_t cap, uint8_t flags, uint16_t seq, const aigis_health_t *health)
+{
+    aigis_writer_t w;
+    aigis_msg_begin(&w, buf, cap, AIGIS_MSG_HEALTH, flags, seq);
+    aigis_put_u8(&w, AIGIS_TAG_HEALTH_EVENT, (health->fall ? AIGIS_HEALTH_FALL : 0) | (health->alarm ? AIGIS_HEALTH_ALARM : 0));
+    aigis_put_u8(&w, AIGIS_TAG_HEART_RATE, health->heart_rate);
+    aigis_put_u8(&w, AIGIS_TAG_SPO2, health->spo2);
+    return aigis_msg_end(&w);
+}
+
+size_t aigis_encode_telemetry(uint8_t *buf, size_t cap, uint8_t flags, uint16_t seq, const aigis_telemetry_t *telemetry)
+{
+    aigis_writer_t w;
+    uint8_t vitals[AIGIS_TELEMETRY_MAX * 4];
+    const size_t count = (telemetry->count < AIGIS_TELEMETRY_MAX) ? telemetry->count : AIGIS_TELEMETRY_MAX;
+    for (size_t i = 0; i < count; i++) {
+        vitals[i * 4 + 0] = telemetry->sample[i].accel_mg & 0xFF;
+        vitals[i * 4 + 1] = telemetry->sample[i].accel_mg >> 8;
+        vitals[i * 4 + 2] = telemetry->sample[i].heart_rate;
+        vitals[i * 4 + 3] = telemetry->sample[i].spo2;
+    }
+    aigis_msg_begin(&w, buf, cap, AIGIS_MSG_TELEMETRY, flags, seq);
+    aigis_put_u16(&w, AIGIS_TAG_FIRST_SAMPLE, telemetry->first);
+    aigis_put_u16(&w, AIGIS_TAG_PERIOD, telemetry->period_ms);
+    aigis_put(&w, AIGIS_TAG_VITALS, vitals, count * 4);
+    return aigis_msg_end(&w);
+}
+
+bool aigis_decode_health(const aigis_msg_t *msg, aigis_health_t *health)
+{
+    if (AIGIS_MSG_HEALTH != msg->type) {
+        return false;
+    }
+    const uint8_t event = aigis_get_u8(msg, AIGIS_TAG_HEALTH_EVENT, 0);
+    health->fall = event & AIGIS_HEALTH_FALL;
+    health->alarm = event & AIGIS_HEALTH_ALARM;
+    health->heart_rate = aigis_get_u8(msg, AIGIS_TAG_HEART_RATE, 0);
+    health->spo2 = aigis_get_u8(msg, AIGIS_TAG_SPO2, 0);
+    return true;
+}
+
+bool aigis_decode_telemetry(const aigis_msg_t *msg, aigis_telemetry_t *telemetry)
+{
+    aigis_tlv_t tlv;
+    if (AIGIS_MSG_TELEMETRY != msg->type || !aigis_tlv_find(msg, AIGIS_TAG_VITALS, &tlv)) {
+        return false;
+    }
+    const size_t count = (tlv.len / 4 < AIGIS_TELEMETRY_MAX) ? tlv.len / 4 : AIGIS_TELEMETRY_MAX;
+    telemetry->first = aigis_get_u16(msg, AIGIS_TAG_FIRST_SAMPLE, 0);
+    telemetry->period_ms = aigis_get_u16(msg, AIGIS_TAG_PERIOD, 0);
+    telemetry->count = count;
+    for (size_t i = 0; i < count; i++) {
+        telemetry->sample[i].accel_mg = tlv.value[i * 4] | (tlv.value[i * 4 + 1] << 8);
+        telemetry->sample[i].heart_rate = tlv.value[i * 4 + 2];
+        telemetry->sample[i].spo2 = tlv.value[i * 4 + 3];
+    }
+    return true;
+}
+
+bool aigis_decode_visitor(const aigis_msg_t *msg, char *name, size_t size)
+{
+    aigis_tlv_t tlv;
+    if (AIGIS_MSG_VISITOR != msg->type || !size || !aigis_tlv_find(msg, AIGIS_TAG_NAME, &tlv)) {
+        return false;
+    }
+    const size_t len = (tlv.len < size - 1) ? tlv.len : size - 1;
+    memcpy(name, tlv.value, len);
+    name[len] = '\0';
+    return true;
+}
@@ -0,0 +1,214 @@
+/*
+ * Aigis Proto: the ESP-NOW wire format shared by the S3 Box hub and the node sketches.
+ *
+ * Every frame is a 4-byte header followed by TLV fields, all little-endian and byte
+ * packed, so the layout does not depend on the compiler of either end:
+ *
+ *     byte 0      version << 4 | flags
+ *     byte 1      message type
+ *     byte 2..3   sequence number
+ *     then        tag (1 byte), length (1 byte), value (length bytes), repeated
+ *
+ * A receiver rejects another version and skips tags it does not know, so fields can
+ * be added to a message without breaking older nodes. The hub builds this folder as an
+ * ESP-IDF component; for the sketches, copy or link it into the Arduino libraries folder.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AIGIS_PROTO_VERSION     (2)
+#define AIGIS_PROTO_HDR_LEN     (4)
+#define AIGIS_PROTO_MAX_FRAME   (250)   /*!< ESP-NOW payload limit */
+#define AIGIS_NAME_MAX          (31)    /*!< Longest visitor name, without terminator */
+#define AIGIS_PUBKEY_LEN        (32)    /*!< X25519 public key */
+#define AIGIS_TELEMETRY_MAX     (48)    /*!< Samples per telemetry frame; a sealed frame of 48 is 218 bytes */
+
+/* Header flags */
+#define AIGIS_FLAG_ACK_REQ      (0x1)   /*!< Receiver must answer with AIGIS_MSG_ACK carrying the same seq */
+#define AIGIS_FLAG_SECURE       (0x2)   /*!< Fields encrypted and authenticated with the link key, see aigis_secure.h */
+
+typedef enum {
+    AIGIS_MSG_ACK       = 0x01,     /*!< No fields */
+    AIGIS_MSG_HELLO     = 0x02,     /*!< Node -> broadcast, until paired: AIGIS_TAG_ROLE, PUBKEY */
+    AIGIS_MSG_PAIR      = 0x03,     /*!< Hub -> node, answer to HELLO: the sender is the hub. AIGIS_TAG_PUBKEY */
+    AIGIS_MSG_CONTROL   = 0x10,     /*!< Hub -> Smart Home Node: AIGIS_TAG_COMMAND */
+    AIGIS_MSG_DOOR      = 0x20,     /*!< Hub -> Door Node: AIGIS_TAG_DOOR_ACTION */
+    AIGIS_MSG_VISITOR   = 0x21,     /*!< Door Node -> hub: AIGIS_TAG_NAME */
+    AIGIS_MSG_HEALTH    = 0x30,     /*!< Health Node -> hub: AIGIS_TAG_HEALTH_EVENT, HEART_RATE, SPO2 */
+    AIGIS_MSG_TELEMETRY = 0x31,     /*!< Health Node -> hub: AIGIS_TAG_FIRST_SAMPLE, PERIOD, VITALS */
+} aigis_msg_type_t;
+
+typedef enum {
+    AIGIS_TAG_COMMAND       = 0x01, /*!< u8, aigis_command_t */
+    AIGIS_TAG_DOOR_ACTION   = 0x02, /*!< u8, aigis_door_action_t */
+    AIGIS_TAG_NAME          = 0x03, /*!< UTF-8, not terminated, up to AIGIS_NAME_MAX bytes */
+    AIGIS_TAG_HEALTH_EVENT  = 0x04, /*!< u8, AIGIS_HEALTH_* bits */
+    AIGIS_TAG_HEART_RATE    = 0x05, /*!< u8, beats per minute, 0 if unknown */
+    AIGIS_TAG_SPO2          = 0x06, /*!< u8, percent, 0 if unknown */
+    AIGIS_TAG_ROLE          = 0x07, /*!< u8, aigis_role_t */
+    AIGIS_TAG_PUBKEY        = 0x08, /*!< AIGIS_PUBKEY_LEN bytes, the sender's key for this pairing */
+    AIGIS_TAG_FIRST_SAMPLE  = 0x09, /*!< u16, number of the first sample; counts on across frames, so gaps show loss */
+    AIGIS_TAG_PERIOD        = 0x0A, /*!< u16, milliseconds between samples */
+    AIGIS_TAG_VITALS        = 0x0B, /*!< 4 bytes per sample, oldest first: accel mg u16, heart rate u8, SpO2 u8 */
+} aigis_tag_t;
+
+/* What a node is; the hub routes frames by the role a MAC paired with */
+typedef enum {
+    AIGIS_ROLE_NONE = 0,
+    AIGIS_ROLE_CONTROL,             /*!< Smart Home Node: lights, socket, fan */
+    AIGIS_ROLE_DOOR,
+    AIGIS_ROLE_HEALTH,
+    AIGIS_ROLE_MAX,
+} aigis_role_t;
+
+/* Smart Home Node commands */
+typedef enum {
+    TURN_ON_LIGHT_ONE = 1,
+    TURN_OFF_LIGHT_ONE,
+    TURN_ON_SOCKET,
+    TURN_OFF_SOCKET,
+    TURN_ON_FAN_AT_LEVEL_ONE,
+    TURN_ON_FAN_AT_LEVEL_TWO,
+    TURN_ON_FAN_AT_LEVEL_THREE,
+    TURN_OFF_FAN
+} aigis_command_t;
+
+typedef enum {
+    AIGIS_DOOR_LOCK = 0,
+    AIGIS_DOOR_UNLOCK,
+} aigis_door_action_t;
+
+#define AIGIS_HEALTH_FALL       (0x1)
+#define AIGIS_HEALTH_ALARM      (0x2)
+
+/* Health Node report */
+typedef struct {
+    bool fall;
+    bool alarm;
+    uint8_t heart_rate;
+    uint8_t spo2;
+} aigis_health_t;
+
+/* One telemetry sample */
+typedef struct {
+    uint16_t accel_mg;              /*!< Acceleration magnitude, 1/1000 g */
+    uint8_t heart_rate;             /*!< Beats per minute, 0 if unknown */
+    uint8_t spo2;                   /*!< Percent, 0 if unknown */
+} aigis_vitals_t;
+
+/* Health Node telemetry: samples taken at a fixed period, sent in one frame */
+typedef struct {
+    uint16_t first;
+    uint16_t period_ms;
+    uint8_t count;
+    aigis_vitals_t sample[AIGIS_TELEMETRY_MAX];
+} aigis_telemetry_t;
+
+/* A received frame; fields point into the caller's buffer */
+typedef struct {
+    uint8_t type;
+    uint8_t flags;
+    uint16_t seq;
+    const uint8_t *tlv;
+    size_t tlv_len;
+} aigis_msg_t;
+
+typedef struct {
+    uint8_t tag;
+    uint8_t len;
+    const uint8_t *value;
+} aigis_tlv_t;
+
+/* Frame under construction; an overflow is remembered and reported by aigis_msg_end() */
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool overflow;
+} aigis_writer_t;
+
+/**
+ * @brief Start a frame in a caller buffer.
+ */
+void aigis_msg_begin(aigis_writer_t *w, uint8_t *buf, size_t cap, uint8_t type, uint8_t flags, uint16_t seq);
+
+/**
+ * @brief Append a field. Values longer than 255 bytes or past the buffer end mark the frame as overflowed.
+ */
+void aigis_put(aigis_writer_t *w, uint8_t tag, const void *value, size_t len);
+void aigis_put_u8(aigis_writer_t *w, uint8_t tag, uint8_t value);
+void aigis_put_u16(aigis_writer_t *w, uint8_t tag, uint16_t value);
+
+/**
+ * @brief Finish a frame.
+ *
+ * @return size_t Frame length, 0 if it did not fit
+ */
+size_t aigis_msg_end(aigis_writer_t *w);
+
+/**
+ * @brief Check a received frame and split it into header and fields.
+ *
+ * Fails on a short frame, another protocol version, or a field running past the end,
+ * so the accessors below never read out of bounds.
+ *
+ * @return bool true if the frame is valid
+ */
+bool aigis_msg_parse(const uint8_t *frame, size_t len, aigis_msg_t *msg);
+
+/**
+ * @brief Iterate the fields of a parsed frame. Start with *pos = 0.
+ *
+ * @return bool false after the last field
+ */
+bool aigis_tlv_next(const aigis_msg_t *msg, size_t *pos, aigis_tlv_t *tlv);
+
+/**
+ * @brief Find the first field with a tag.
+ *
+ * @return bool false if the frame has no such field
+ */
+bool aigis_tlv_find(const aigis_msg_t *msg, uint8_t tag, aigis_tlv_t *tlv);
+
+/**
+ * @brief Read a u8 field, or return def if it is missing or has another size.
+ */
+uint8_t aigis_get_u8(const aigis_msg_t *msg, uint8_t tag, uint8_t def);
+uint16_t aigis_get_u16(const aigis_msg_t *msg, uint8_t tag, uint16_t def);
+
+/* Encoders of the messages above; each returns the frame length, 0 if cap is too small */
+size_t aigis_encode_ack(uint8_t *buf, size_t cap, uint16_t seq);
+size_t aigis_encode_hello(uint8_t *buf, size_t cap, uint16_t seq, aigis_role_t role, const uint8_t *pubkey);
+size_t aigis_encode_pair(uint8_t *buf, size_t cap, uint16_t seq, const uint8_t *pubkey);
+size_t aigis_encode_control(uint8_t *buf, size_t cap, uint8_t flags, uint16_t seq, aigis_command_t command);
+size_t aigis_encode_door(uint8_t *buf, size_t cap, uint8_t flags, uint16_t seq, aigis_door_action_t action);
+size_t aigis_encode_visitor(uint8_t *buf, size_t cap, uint8_t flags, uint16_t seq, const char *name);
+size_t aigis_encode_health(uint8_t *buf, size_t cap, uint8_t flags, uint16_t seq, const aigis_health_t *health);
+size_t aigis_encode_telemetry(uint8_t *buf, size_t cap, uint8_t flags, uint16_t seq, const aigis_telemetry_t *telemetry);
+
+/**
+ * @brief Decode an AIGIS_MSG_HEALTH frame. Missing fields read as 0.
+ */
+bool aigis_decode_health(const aigis_msg_t *msg, aigis_health_t *health);
+
+/**
+ * @brief Decode an AIGIS_MSG_TELEMETRY frame. Samples past AIGIS_TELEMETRY_MAX are ignored.
+ */
+bool aigis_decode_telemetry(const aigis_msg_t *msg, aigis_telemetry_t *telemetry);
+
+/**
+ * @brief Decode an AIGIS_MSG_VISITOR frame into a terminated string, truncated to fit.
+ */
+bool aigis_decode_visitor(const aigis_msg_t *msg, char *name, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,167 @@
+/*
+ * Aigis Secure: link keys and sealed frames for the ESP-NOW wire format.
+ */
+
+#include "aigis_secure.h"
+
+#include <string.h>
+#include "esp_random.h"
+#include "mbedtls/ccm.h"
+#include "mbedtls/ecdh.h"
+#include "mbedtls/sha256.h"
+
+#define SECURE_NONCE_LEN    (13)    /* CCM with a 2-byte length field */
+
+static int secure_rng(void *ctx, unsigned char *buf, size_t len)
+{
+    (void)ctx;
+    esp_fill_random(buf, len);
+    return 0;
+}
+
+bool aigis_keypair_gen(aigis_keypair_t *kp)
+{
+    mbedtls_ecp_group grp;
+    mbedtls_mpi d;
+    mbedtls_ecp_point q;
+    size_t olen;
+
+    mbedtls_ecp_group_init(&grp);
+    mbedtls_mpi_init(&d);
+    mbedtls_ecp_point_init(&q);
+    int ret = mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_CURVE25519);
+    if (!ret) {
+        ret = mbedtls_ecdh_gen_public(&grp, &d, &q, secure_rng, NULL);
+    }
+    if (!ret) {
+        ret = mbedtls_mpi_write_binary_le(&d, kp->priv, sizeof(kp->priv));
+    }
+    if (!ret) {
+        ret = mbedtls_ecp_point_write_binary(&grp, &q, MBEDTLS_ECP_PF_UNCOMPRESSED, &olen, kp->pub, sizeof(kp->pub));
+    }
+    mbedtls_ecp_point_free(&q);
+    mbedtls_mpi_free(&d);
+    mbedtls_ecp_group_free(&grp);
+    return 0 == ret;
+}
+
+bool aigis_key_derive(const aigis_keypair_t *kp, const uint8_t *peer_pub, uint8_t *key)
+{
+    mbedtls_ecp_group grp;
+    mbedtls_mpi d, z;
+    mbedtls_ecp_point q;
+    uint8_t secret[32];
+    uint8_t digest[32];
+
+    mbedtls_ecp_group_init(&grp);
+    mbedtls_mpi_init(&d);
+    mbedtls_mpi_init(&z);
+    mbedtls_ecp_point_init(&q);
+    int ret = mbedtls_ecp_group_load(&grp, MBEDTLS_ECP_DP_CURVE25519);
+    if (!ret) {
+        ret = mbedtls_mpi_read_binary_le(&d, kp->priv, sizeof(kp->priv));
+    }
+    if (!ret) {
+        ret = mbedtls_ecp_point_read_binary(&grp, &q, peer_pub, AIGIS_PUBKEY_LEN);
+    }
+    if (!ret) {
+        ret = mbedtls_ecp_check_pubkey(&grp, &q);
+    }
+    if (!ret) {
+        ret = mbedtls_ecdh_compute_shared(&grp, &z, &q, &d, secure_rng, NULL);
+    }
+    /* A low-order peer key gives an all-zero secret that anyone can compute */
+    if (!ret && 0 == mbedtls_mpi_cmp_int(&z, 0)) {
+        ret = -1;
+    }
+    if (!ret) {
+        ret = mbedtls_mpi_write_binary_le(&z, secret, sizeof(secret));
+    }
+    if (!ret) {
+        ret = mbedtls_sha256(secret, sizeof(secret), digest, 0);
+    }
+    if (!ret) {
+        memcpy(key, digest, AIGIS_KEY_LEN);
+    }
+    memset(secret, 0, sizeof(secret));
+    memset(digest, 0, sizeof(digest));
+    mbedtls_ecp_point_free(&q);
+    mbedtls_mpi_free(&z);
+    mbedtls_mpi_free(&d);
+    mbedtls_ecp_group_free(&grp);
+    return 0 == ret;
+}
+
+bool aigis_is_sealed(const uint8_t *frame, size_t len)
+{
+    return frame && len >= AIGIS_PROTO_HDR_LEN + AIGIS_SEAL_OVERHEAD && len <= AIGIS_PROTO_MAX_FRAME
+           && AIGIS_PROTO_VERSION == (frame[0] >> 4) && (frame[0] & AIGIS_FLAG_SECURE);
+}
+
+static void secure_nonce(uint8_t *nonce, const uint8_t *sender, const uint8_t *ctr)
+{
+    memcpy(nonce, sender, 6);
+    memcpy(nonce + 6, ctr, AIGIS_CTR_LEN);
+    memset(nonce + 6 + AIGIS_CTR_LEN, 0, SECURE_NONCE_LEN - 6 - AIGIS_CTR_LEN);
+}
+
+size_t aigis_seal(uint8_t *frame, size_t len, size_t cap, const uint8_t *key, const uint8_t *sender, uint32_t ctr)
+{
+    if (len < AIGIS_PROTO_HDR_LEN || len + AIGIS_SEAL_OVERHEAD > cap || len + AIGIS_SEAL_OVERHEAD > AIGIS_PROTO_MAX_FRAME) {
+        return 0;
+    }
+    uint8_t plain[AIGIS_PROTO_MAX_FRAME];
+    uint8_t nonce[SECURE_NONCE_LEN];
+    const size_t plain_len = len - AIGIS_PROTO_HDR_LEN;
+    uint8_t *ctr_le = frame + AIGIS_PROTO_HDR_LEN;
+    uint8_t *body = ctr_le + AIGIS_CTR_LEN;
+
+    memcpy(plain, frame + AIGIS_PROTO_HDR_LEN, plain_len);
+    frame[0] |= AIGIS_FLAG_SECURE;
+    ctr_le[0] = ctr & 0xFF;
+    ctr_le[1] = (ctr >> 8) & 0xFF;
+    ctr_le[2] = (ctr >> 16) & 0xFF;
+    ctr_le[3] = ctr >> 24;
+    secure_nonce(nonce, sender, ctr_le);
+
+    mbedtls_ccm_context ccm;
+    mbedtls_ccm_init(&ccm);
+    int ret = mbedtls_ccm_setkey(&ccm, MBEDTLS_CIPHER_ID_AES, key, AIGIS_KEY_LEN * 8);
+    if (!ret) {
+        ret = mbedtls_ccm_encrypt_and_tag(&ccm, plain_len, nonce, sizeof(nonce), frame, AIGIS_PROTO_HDR_LEN + AIGIS_CTR_LEN,
+                                          plain, body, body + plain_len, AIGIS_MIC_LEN);
+    }
+    mbedtls_ccm_free(&ccm);
+    return ret ? 0 : len + AIGIS_SEAL_OVERHEAD;
+}
+
+size_t aigis_open(uint8_t *frame, size_t len, const uint8_t *key, const uint8_t *sender, uint32_t *ctr)
+{
+    if (!aigis_is_sealed(frame, len)) {
+        return 0;
+    }
+    uint8_t plain[AIGIS_PROTO_MAX_FRAME];
+    uint8_t nonce[SECURE_NONCE_LEN];
+    const size_t plain_len = len - AIGIS_PROTO_HDR_LEN - AIGIS_SEAL_OVERHEAD;
+    const uint8_t *ctr_le = frame + AIGIS_PROTO_HDR_LEN;
+    const uint8_t *body = ctr_le + AIGIS_CTR_LEN;
+
+    secure_nonce(nonce, sender, ctr_le);
+
+    mbedtls_ccm_context ccm;
+    mbedtls_ccm_init(&ccm);
+    int ret = mbedtls_ccm_setkey(&ccm, MBEDTLS_CIPHER_ID_AES, key, AIGIS_KEY_LEN * 8);
+    if (!ret) {
+        ret = mbedtls_ccm_auth_decrypt(&ccm, plain_len, nonce, sizeof(nonce), frame, AIGIS_PROTO_HDR_LEN + AIGIS_CTR_LEN,
+                                       body, plain, body + plain_len, AIGIS_MIC_LEN);
+    }
+    mbedtls_ccm_free(&ccm);
+    if (ret) {
+        return 0;
+    }
+
+    *ctr = ctr_le[0] | (ctr_le[1] << 8) | (ctr_le[2] << 16) | ((uint32_t)ctr_le[3] << 24);
+    /* The flag stays set, so the parsed message shows it was authenticated */
+    memcpy(frame + AIGIS_PROTO_HDR_LEN, plain, plain_len);
+    return AIGIS_PROTO_HDR_LEN + plain_len;
+}
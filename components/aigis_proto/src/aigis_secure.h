@@ -0,0 +1,77 @@
+/*
+ * Aigis Secure: link keys and sealed frames for the ESP-NOW wire format.
+ *
+ * HELLO and PAIR carry an X25519 public key each way; both ends derive the 16-byte link
+ * key from the shared secret with SHA-256. Every other frame is sealed with AES-128-CCM:
+ *
+ *     byte 0..3   header, AIGIS_FLAG_SECURE set, authenticated but not encrypted
+ *     byte 4..7   counter, little-endian
+ *     then        encrypted fields, then an AIGIS_MIC_LEN tag
+ *
+ * The nonce is the sender MAC and the counter, so one key serves both directions. A sender
+ * never repeats a counter under one key, across reboots too, and a receiver only takes a
+ * counter above the last one it accepted, so a recorded frame cannot be played again.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "aigis_proto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AIGIS_KEY_LEN           (16)
+#define AIGIS_CTR_LEN           (4)
+#define AIGIS_MIC_LEN           (8)
+#define AIGIS_SEAL_OVERHEAD     (AIGIS_CTR_LEN + AIGIS_MIC_LEN)
+
+/* Key pair for one pairing; discard it once the link key is derived */
+typedef struct {
+    uint8_t priv[32];
+    uint8_t pub[AIGIS_PUBKEY_LEN];
+} aigis_keypair_t;
+
+/**
+ * @brief Make a fresh X25519 key pair from the hardware RNG.
+ */
+bool aigis_keypair_gen(aigis_keypair_t *kp);
+
+/**
+ * @brief Derive the link key from our key pair and the peer's public key.
+ *
+ * @return bool false if the peer key is not valid
+ */
+bool aigis_key_derive(const aigis_keypair_t *kp, const uint8_t *peer_pub, uint8_t *key);
+
+/**
+ * @brief Check the header of a received frame for AIGIS_FLAG_SECURE; it is not authenticated yet.
+ */
+bool aigis_is_sealed(const uint8_t *frame, size_t len);
+
+/**
+ * @brief Seal a frame built by the encoders, in place.
+ *
+ * @param cap Size of the frame buffer, at least len + AIGIS_SEAL_OVERHEAD
+ * @param sender MAC of this device
+ * @param ctr Counter, above every counter used before with this key
+ * @return size_t Sealed length, 0 on failure
+ */
+size_t aigis_seal(uint8_t *frame, size_t len, size_t cap, const uint8_t *key, const uint8_t *sender, uint32_t ctr);
+
+/**
+ * @brief Check and decrypt a sealed frame in place, leaving a frame for aigis_msg_parse().
+ *
+ * The caller must still compare *ctr with the last counter taken from the sender.
+ *
+ * @param sender MAC the frame came from
+ * @return size_t Plain length, 0 if the frame is forged, damaged or sealed with another key
+ */
+size_t aigis_open(uint8_t *frame, size_t len, const uint8_t *key, const uint8_t *sender, uint32_t *ctr);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,182 @@
+/*
+ * Host test: aigis_proto encode/decode round trips, then fuzzing of the parser and decoders.
+ *
+ * Built with AddressSanitizer and UBSan where the compiler has them, so any read past a
+ * frame or an undefined shift fails the run. The fuzz rounds default to 200000; pass a
+ * number to change it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "aigis_proto.h"
+
+static int s_fails = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            printf("FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+            s_fails++; \
+        } \
+    } while (0)
+
+static uint32_t s_rng = 1;
+
+static uint32_t rnd(void)
+{
+    /* xorshift32, so runs are the same on every host */
+    s_rng ^= s_rng << 13;
+    s_rng ^= s_rng >> 17;
+    s_rng ^= s_rng << 5;
+    return s_rng;
+}
+
+static void test_round_trip(void)
+{
+    uint8_t frame[AIGIS_PROTO_MAX_FRAME];
+    uint8_t key[AIGIS_PUBKEY_LEN];
+    aigis_msg_t msg;
+    aigis_tlv_t tlv;
+
+    for (size_t i = 0; i < sizeof(key); i++) {
+        key[i] = i * 7;
+    }
+
+    size_t len = aigis_encode_ack(frame, sizeof(frame), 0xBEEF);
+    CHECK(AIGIS_PROTO_HDR_LEN == len && aigis_msg_parse(frame, len, &msg));
+    CHECK(AIGIS_MSG_ACK == msg.type && 0xBEEF == msg.seq && 0 == msg.tlv_len);
+
+    len = aigis_encode_hello(frame, sizeof(frame), 7, AIGIS_ROLE_DOOR, key);
+    CHECK(len && aigis_msg_parse(frame, len, &msg) && AIGIS_MSG_HELLO == msg.type);
+    CHECK(AIGIS_ROLE_DOOR == aigis_get_u8(&msg, AIGIS_TAG_ROLE, 0));
+    CHECK(aigis_tlv_find(&msg, AIGIS_TAG_PUBKEY, &tlv) && AIGIS_PUBKEY_LEN == tlv.len && !memcmp(tlv.value, key, sizeof(key)));
+
+    len = aigis_encode_pair(frame, sizeof(frame), 8, key);
+    CHECK(len && aigis_msg_parse(frame, len, &msg) && AIGIS_MSG_PAIR == msg.type);
+    CHECK(aigis_tlv_find(&msg, AIGIS_TAG_PUBKEY, &tlv) && !memcmp(tlv.value, key, sizeof(key)));
+
+    len = aigis_encode_control(frame, sizeof(frame), AIGIS_FLAG_ACK_REQ, 9, TURN_ON_FAN_AT_LEVEL_TWO);
+    CHECK(len && aigis_msg_parse(frame, len, &msg) && AIGIS_MSG_CONTROL == msg.type && AIGIS_FLAG_ACK_REQ == msg.flags);
+    CHECK(TURN_ON_FAN_AT_LEVEL_TWO == aigis_get_u8(&msg, AIGIS_TAG_COMMAND, 0));
+
+    len = aigis_encode_door(frame, sizeof(frame), 0, 10, AIGIS_DOOR_UNLOCK);
+    CHECK(len && aigis_msg_parse(frame, len, &msg) && AIGIS_MSG_DOOR == msg.type);
+    CHECK(AIGIS_DOOR_UNLOCK == aigis_get_u8(&msg, AIGIS_TAG_DOOR_ACTION, 0xFF));
+
+    /* Names longer than AIGIS_NAME_MAX are cut on the wire, then to the caller's buffer */
+    char name[AIGIS_NAME_MAX + 1];
+    len = aigis_encode_visitor(frame, sizeof(frame), 0, 11, "Alice");
+    CHECK(len && aigis_msg_parse(frame, len, &msg) && aigis_decode_visitor(&msg, name, sizeof(name)) && !strcmp(name, "Alice"));
+    len = aigis_encode_visitor(frame, sizeof(frame), 0, 12, "A visitor whose name is far longer than thirty-one bytes");
+    CHECK(len && aigis_msg_parse(frame, len, &msg) && aigis_decode_visitor(&msg, name, sizeof(name)) && AIGIS_NAME_MAX == strlen(name));
+    CHECK(aigis_decode_visitor(&msg, name, 4) && !strcmp(name, "A v"));
+
+    aigis_health_t health = { .fall = true, .alarm = false, .heart_rate = 72, .spo2 = 97 }, got_health;
+    len = aigis_encode_health(frame, sizeof(frame), 0, 13, &health);
+    CHECK(len && aigis_msg_parse(frame, len, &msg) && aigis_decode_health(&msg, &got_health));
+    CHECK(got_health.fall && !got_health.alarm && 72 == got_health.heart_rate && 97 == got_health.spo2);
+
+    static aigis_telemetry_t tel, got_tel;
+    tel.first = 65530;
+    tel.period_ms = 100;
+    tel.count = AIGIS_TELEMETRY_MAX;
+    for (int i = 0; i < AIGIS_TELEMETRY_MAX; i++) {
+        tel.sample[i] = (aigis_vitals_t) { .accel_mg = 1000 + i * 37, .heart_rate = 60 + i, .spo2 = 90 + i % 10 };
+    }
+    len = aigis_encode_telemetry(frame, sizeof(frame), 0, 14, &tel);
+    CHECK(len && aigis_msg_parse(frame, len, &msg) && aigis_decode_telemetry(&msg, &got_tel));
+    CHECK(got_tel.first == tel.first && got_tel.period_ms == tel.period_ms && got_tel.count == tel.count
+          && !memcmp(got_tel.sample, tel.sample, sizeof(tel.sample)));
+
+    /* A short buffer reports overflow as 0, never a partial frame */
+    for (size_t cap = 0; cap < 4 + 3 + 34; cap++) {
+        CHECK(0 == aigis_encode_hello(frame, cap, 1, AIGIS_ROLE_HEALTH, key));
+    }
+
+    /* Wrong version, short and oversized frames are rejected */
+    len = aigis_encode_ack(frame, sizeof(frame), 1);
+    frame[0] ^= 0x10;
+    CHECK(!aigis_msg_parse(frame, len, &msg));
+    CHECK(!aigis_msg_parse(frame, AIGIS_PROTO_HDR_LEN - 1, &msg));
+    CHECK(!aigis_msg_parse(frame, AIGIS_PROTO_MAX_FRAME + 1, &msg));
+
+    /* Unknown tags are skipped */
+    aigis_writer_t w;
+    aigis_msg_begin(&w, frame, sizeof(frame), AIGIS_MSG_CONTROL, 0, 15);
+    aigis_put(&w, 0xEE, "xyz", 3);
+    aigis_put_u8(&w, AIGIS_TAG_COMMAND, TURN_OFF_FAN);
+    len = aigis_msg_end(&w);
+    CHECK(len && aigis_msg_parse(frame, len, &msg) && TURN_OFF_FAN == aigis_get_u8(&msg, AIGIS_TAG_COMMAND, 0));
+}
+
+/* Everything a receiver may do with a frame; each field access must stay inside it */
+static void exercise(const uint8_t *frame, size_t len)
+{
+    aigis_msg_t msg;
+    aigis_tlv_t tlv;
+    if (!aigis_msg_parse(frame, len, &msg)) {
+        return;
+    }
+    size_t pos = 0, fields = 0;
+    while (aigis_tlv_next(&msg, &pos, &tlv)) {
+        CHECK(tlv.value >= msg.tlv && tlv.value + tlv.len <= msg.tlv + msg.tlv_len);
+        fields++;
+    }
+    CHECK(pos == msg.tlv_len && fields <= msg.tlv_len / 2);
+
+    aigis_health_t health;
+    static aigis_telemetry_t tel;
+    char name[AIGIS_NAME_MAX + 1];
+    (void)aigis_decode_health(&msg, &health);
+    if (aigis_decode_telemetry(&msg, &tel)) {
+        CHECK(tel.count <= AIGIS_TELEMETRY_MAX);
+    }
+    if (aigis_decode_visitor(&msg, name, sizeof(name))) {
+        CHECK(strlen(name) <= AIGIS_NAME_MAX);
+    }
+    (void)aigis_get_u16(&msg, AIGIS_TAG_FIRST_SAMPLE, 0);
+}
+
+static void fuzz(long rounds)
+{
+    for (long r = 0; r < rounds; r++) {
+        /* Exact-size heap copy, so ASan flags a read one byte past the frame */
+        uint8_t seed[AIGIS_PROTO_MAX_FRAME + 8];
+        size_t len;
+        if (r & 1) {
+            /* Valid frame, then bit flips and a random length */
+            static aigis_telemetry_t tel;
+            tel.count = rnd() % (AIGIS_TELEMETRY_MAX + 1);
+            len = aigis_encode_telemetry(seed, sizeof(seed), 0, r, &tel);
+            if (rnd() & 1) {
+                len = aigis_encode_visitor(seed, sizeof(seed), 0, r, "fuzz");
+            }
+            for (int flips = rnd() % 4; flips >= 0; flips--) {
+                seed[rnd() % len] ^= 1 << (rnd() % 8);
+            }
+            len = (rnd() & 3) ? len : rnd() % (sizeof(seed) + 1);
+        } else {
+            /* Random bytes with a valid version nibble */
+            len = rnd() % (sizeof(seed) + 1);
+            for (size_t i = 0; i < len; i++) {
+                seed[i] = rnd();
+            }
+            if (len) {
+                seed[0] = (seed[0] & 0x0F) | (AIGIS_PROTO_VERSION << 4);
+            }
+        }
+        uint8_t *frame = malloc(len ? len : 1);
+        memcpy(frame, seed, len);
+        exercise(frame, len);
+        free(frame);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const long rounds = (argc > 1) ? atol(argv[1]) : 200000;
+    test_round_trip();
+    fuzz(rounds);
+    printf("aigis_proto: round trips and %ld fuzz rounds, %d failures\n", rounds, s_fails);
+    return s_fails != 0;
+}
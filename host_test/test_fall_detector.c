@@ -0,0 +1,149 @@
+/*
+ * Host test: replays accelerometer traces through fall_detector.c and checks the falls it reports.
+ *
+ * A trace is a CSV of raw x,y,z counts, one sample per line, as printed by CDHealth_Node.ino with
+ * ACCEL_TRACE_ENABLED. Lines starting with '#' carry the settings and the expected result:
+ *
+ *   # rate_hz 100
+ *   # lsb_per_g 4096
+ *   # falls 1
+ *
+ * Any other line that is not three integers (e.g. a log line from the sketch) is skipped.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "fall_detector.h"
+
+#define MAX_SAMPLES     (60 * 100)  /* One minute at 100 Hz */
+#define BENCH_ROUNDS    (2000)
+
+typedef struct {
+    unsigned rate_hz;
+    unsigned lsb_per_g;
+    int falls;                      /* Expected; -1 when the trace does not say */
+    size_t n;
+    int16_t xyz[MAX_SAMPLES][3];
+} trace_t;
+
+static trace_t s_trace;
+
+static bool load_trace(const char *path, trace_t *t)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    t->rate_hz = 100;
+    t->lsb_per_g = 4096;
+    t->falls = -1;
+    t->n = 0;
+
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        int x, y, z;
+        if ('#' == line[0]) {
+            sscanf(line, "# rate_hz %u", &t->rate_hz);
+            sscanf(line, "# lsb_per_g %u", &t->lsb_per_g);
+            sscanf(line, "# falls %d", &t->falls);
+        } else if (3 == sscanf(line, "%d,%d,%d", &x, &y, &z)) {
+            if (t->n == MAX_SAMPLES) {
+                printf("FAIL: %s: longer than %d samples\n", path, MAX_SAMPLES);
+                fclose(f);
+                return false;
+            }
+            t->xyz[t->n][0] = x;
+            t->xyz[t->n][1] = y;
+            t->xyz[t->n][2] = z;
+            t->n++;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+/* Falls reported over the trace; also checks the telemetry magnitude of every sample */
+static int replay(const trace_t *t, const char *name, int *bad_mg)
+{
+    fall_detector_t fd;
+    fall_detector_config_t cfg = FALL_DETECTOR_DEFAULT_CONFIG();
+    fall_detector_init(&fd, &cfg, t->rate_hz, t->lsb_per_g);
+
+    int falls = 0;
+    for (size_t i = 0; i < t->n; i++) {
+        const int16_t *s = t->xyz[i];
+        if (fall_detector_update(&fd, s[0], s[1], s[2])) {
+            printf("%s: fall at %.2f s\n", name, (double)i / t->rate_hz);
+            falls++;
+        }
+        const double mg = sqrt((double)s[0] * s[0] + (double)s[1] * s[1] + (double)s[2] * s[2]) * 1000 / t->lsb_per_g;
+        if (fabs(fall_detector_last_mg(&fd) - fmin(mg, UINT16_MAX)) > 1.5) {
+            (*bad_mg)++;
+        }
+    }
+    return falls;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static double bench(const trace_t *t)
+{
+    fall_detector_t fd;
+    fall_detector_config_t cfg = FALL_DETECTOR_DEFAULT_CONFIG();
+    fall_detector_init(&fd, &cfg, t->rate_hz, t->lsb_per_g);
+
+    int falls = 0;
+    const double start = now_ns();
+    for (int r = 0; r < BENCH_ROUNDS; r++) {
+        for (size_t i = 0; i < t->n; i++) {
+            falls += fall_detector_update(&fd, t->xyz[i][0], t->xyz[i][1], t->xyz[i][2]);
+        }
+    }
+    __asm__ volatile("" ::"r"(falls));
+    return (now_ns() - start) / BENCH_ROUNDS / t->n;
+}
+
+int main(int argc, char **argv)
+{
+    const bool bench_on = (argc > 1 && 0 == strcmp(argv[1], "--bench"));
+    const int first = bench_on ? 2 : 1;
+    int fails = 0;
+
+    if (argc <= first) {
+        printf("usage: %s [--bench] trace.csv...\n", argv[0]);
+        return 2;
+    }
+    for (int a = first; a < argc; a++) {
+        const char *name = strrchr(argv[a], '/') ? strrchr(argv[a], '/') + 1 : argv[a];
+        if (!load_trace(argv[a], &s_trace)) {
+            fails++;
+            continue;
+        }
+        int bad_mg = 0;
+        const int falls = replay(&s_trace, name, &bad_mg);
+        if (bad_mg) {
+            printf("FAIL: %s: %d magnitudes off by more than 1.5 mg\n", name, bad_mg);
+            fails++;
+        }
+        if (s_trace.falls >= 0 && falls != s_trace.falls) {
+            printf("FAIL: %s: %d falls, expected %d\n", name, falls, s_trace.falls);
+            fails++;
+        }
+        if (bench_on && s_trace.n) {
+            printf("%s: %zu samples, %.1f ns/sample\n", name, s_trace.n, bench(&s_trace));
+        }
+    }
+    if (!fails) {
+        printf("fall_detector: %d traces ok\n", argc - first);
+    }
+    return fails ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+#!/usr/bin/env python3
+"""
+Host test: golden-image check of gui/image/gen_lv_img.py, which converts the UI
+images to RGB565 at build time.
+
+A 3x2 24-bpp BMP (bottom-up, padded rows) and the same pixels as headerless
+top-down BGR must come out as the hand-computed RGB565 below, in both byte
+orders.
+"""
+
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+
+TOOL = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'main', 'gui', 'image', 'gen_lv_img.py')
+
+# Top-down (B, G, R) pixels and their RGB565 values
+PIXELS = [
+    [(0x00, 0x00, 0xFF), (0x00, 0xFF, 0x00), (0xFF, 0x00, 0x00)],
+    [(0xFF, 0xFF, 0xFF), (0x12, 0x34, 0x56), (0x00, 0x00, 0x00)],
+]
+GOLDEN = [0xF800, 0x07E0, 0x001F, 0xFFFF, 0x51A2, 0x0000]
+
+
+def bmp_bytes():
+    width, height = 3, 2
+    stride = (width * 3 + 3) & ~3
+    rows = b''
+    for row in reversed(PIXELS):
+        data = b''.join(bytes(px) for px in row)
+        rows += data + b'\0' * (stride - len(data))
+    header = struct.pack('<2sIHHI', b'BM', 54 + len(rows), 0, 0, 54)
+    info = struct.pack('<IiiHHIIiiII', 40, width, height, 1, 24, 0, len(rows), 2835, 2835, 0, 0)
+    return header + info + rows
+
+
+def raw_bytes():
+    return b''.join(bytes(px) for row in PIXELS for px in row)
+
+
+def convert(data, swap, tmp):
+    src = os.path.join(tmp, 'img.h')
+    out = os.path.join(tmp, 'img.c')
+    with open(src, 'w') as f:
+        f.write('const unsigned char img[] = {%s};\n' % ', '.join('0x%02x' % b for b in data))
+    args = [sys.executable, TOOL, src, '-o', out, '-n', 'img', '--width', '3', '--height', '2']
+    if swap:
+        args.append('--swap')
+    subprocess.run(args, check=True)
+    with open(out) as f:
+        text = f.read()
+    body = text[text.index('img_map[] = {'):text.index('};')]
+    return bytes(int(v, 16) for v in re.findall(r'0x([0-9a-f]{2})', body))
+
+
+def main():
+    fails = 0
+    with tempfile.TemporaryDirectory() as tmp:
+        for name, data in (('bmp', bmp_bytes()), ('raw', raw_bytes())):
+            for swap in (False, True):
+                want = struct.pack(('>' if swap else '<') + '%dH' % len(GOLDEN), *GOLDEN)
+                got = convert(data, swap, tmp)
+                if got != want:
+                    print('FAIL: %s swap=%d: %s != %s' % (name, swap, got.hex(), want.hex()))
+                    fails += 1
+    print('gen_lv_img: 4 conversions, %d failures' % fails)
+    return 1 if fails else 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
@@ -0,0 +1,278 @@
+/*
+ * Host test: vitals_estimator.c against the Maxim batch routine it replaced, plus a benchmark.
+ *
+ * Both run over synthetic PPG at 25 Hz (heart rates 48-170 bpm, red/IR ratios 0.45-1.2, with
+ * beat-to-beat variation, baseline drift and noise) and are scored against the values the
+ * signal was made with. The batch routine gets the last 100 samples once a second, as the
+ * sketch used to call it. The streaming estimator must be right at least as often, and where
+ * both are right their SpO2 must agree within 2 %.
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "vitals_estimator.h"
+
+#define RATE_HZ         (25)
+#define SAMPLES         (3000)      /* Two minutes per case */
+#define WARMUP          (200)       /* Samples before the first check */
+#define BENCH_ROUNDS    (20)
+
+/* The batch routine from spo2_algorithm.cpp (Maxim reference, SparkFun MAX3010x library), restated */
+#define BATCH_LEN       (100)
+#define BATCH_MA4       (4)
+#define BATCH_PEAKS     (15)
+
+static void sort_ascend(int32_t *x, int n)
+{
+    for (int i = 1; i < n; i++) {
+        const int32_t t = x[i];
+        int j = i;
+        for (; j > 0 && t < x[j - 1]; j--) {
+            x[j] = x[j - 1];
+        }
+        x[j] = t;
+    }
+}
+
+static void sort_indices_descend(const int32_t *x, int32_t *idx, int n)
+{
+    for (int i = 1; i < n; i++) {
+        const int32_t t = idx[i];
+        int j = i;
+        for (; j > 0 && x[t] > x[idx[j - 1]]; j--) {
+            idx[j] = idx[j - 1];
+        }
+        idx[j] = t;
+    }
+}
+
+static void peaks_above(int32_t *locs, int32_t *n, const int32_t *x, int size, int32_t height)
+{
+    int i = 1;
+    *n = 0;
+    while (i < size - 1) {
+        if (x[i] > height && x[i] > x[i - 1]) {
+            int width = 1;
+            while (i + width < size && x[i] == x[i + width]) {
+                width++;
+            }
+            if (x[i] > x[i + width] && *n < BATCH_PEAKS) {
+                locs[(*n)++] = i;
+                i += width + 1;
+            } else {
+                i += width;
+            }
+        } else {
+            i++;
+        }
+    }
+}
+
+static void remove_close_peaks(int32_t *locs, int32_t *n, const int32_t *x, int32_t min_distance)
+{
+    sort_indices_descend(x, locs, *n);
+    for (int i = -1; i < *n; i++) {
+        const int old = *n;
+        *n = i + 1;
+        for (int j = i + 1; j < old; j++) {
+            const int dist = locs[j] - (-1 == i ? -1 : locs[i]);
+            if (dist > min_distance || dist < -min_distance) {
+                locs[(*n)++] = locs[j];
+            }
+        }
+    }
+    sort_ascend(locs, *n);
+}
+
+static int spo2_from_ratio(int32_t r)
+{
+    const double R = r / 100.0;
+    const double v = -45.060 * R * R + 30.354 * R + 94.845;
+    return (int)lround(fmin(fmax(v, 0), 100));
+}
+
+/* Heart rate and SpO2 of the last BATCH_LEN samples, 0 when not valid */
+static void batch_vitals(const uint32_t *ir, const uint32_t *red, int *heart_rate, int *spo2)
+{
+    int32_t x[BATCH_LEN], valleys[BATCH_PEAKS], n_valleys;
+    uint32_t mean = 0;
+
+    for (int k = 0; k < BATCH_LEN; k++) {
+        mean += ir[k];
+    }
+    mean /= BATCH_LEN;
+    for (int k = 0; k < BATCH_LEN; k++) {
+        x[k] = -((int32_t)ir[k] - (int32_t)mean);
+    }
+    for (int k = 0; k < BATCH_LEN - BATCH_MA4; k++) {
+        x[k] = (x[k] + x[k + 1] + x[k + 2] + x[k + 3]) / 4;
+    }
+    int32_t th = 0;
+    for (int k = 0; k < BATCH_LEN; k++) {
+        th += x[k];
+    }
+    th /= BATCH_LEN;
+    th = (th < 30) ? 30 : (th > 60) ? 60 : th;
+    peaks_above(valleys, &n_valleys, x, BATCH_LEN, th);
+    remove_close_peaks(valleys, &n_valleys, x, 4);
+
+    *heart_rate = 0;
+    if (n_valleys >= 2) {
+        const int32_t interval = (valleys[n_valleys - 1] - valleys[0]) / (n_valleys - 1);
+        *heart_rate = RATE_HZ * 60 / interval;
+    }
+
+    int32_t ratio[5];
+    int n_ratio = 0;
+    for (int k = 0; k < n_valleys - 1; k++) {
+        const int32_t v0 = valleys[k], v1 = valleys[k + 1];
+        if (v1 - v0 <= 3) {
+            continue;
+        }
+        int32_t ir_max = INT32_MIN, red_max = INT32_MIN, ir_at = 0, red_at = 0;
+        for (int i = v0; i < v1; i++) {
+            if ((int32_t)ir[i] > ir_max) {
+                ir_max = ir[i];
+                ir_at = i;
+            }
+            if ((int32_t)red[i] > red_max) {
+                red_max = red[i];
+                red_at = i;
+            }
+        }
+        const int32_t red_ac = red_max - ((int32_t)red[v0] + ((int32_t)red[v1] - (int32_t)red[v0]) * (red_at - v0) / (v1 - v0));
+        const int32_t ir_ac = ir_max - ((int32_t)ir[v0] + ((int32_t)ir[v1] - (int32_t)ir[v0]) * (ir_at - v0) / (v1 - v0));
+        const int32_t nume = (red_ac * ir_max) >> 7;
+        const int32_t denom = (ir_ac * red_max) >> 7;
+        if (denom > 0 && n_ratio < 5 && nume != 0) {
+            ratio[n_ratio++] = nume * 100 / denom;
+        }
+    }
+    *spo2 = 0;
+    if (n_ratio) {
+        sort_ascend(ratio, n_ratio);
+        const int mid = n_ratio / 2;
+        const int32_t r = (mid > 1) ? (ratio[mid - 1] + ratio[mid]) / 2 : ratio[mid];
+        if (r > 2 && r < 184) {
+            *spo2 = spo2_from_ratio(r);
+        }
+    }
+}
+
+/* One period of the pulse, 0 to -1: a sharp systolic dip and a slow recovery */
+static double pulse(double phase)
+{
+    phase -= floor(phase);
+    return (phase < 0.15) ? -sin(M_PI / 2 * phase / 0.15) : -exp(-(phase - 0.15) / 0.2);
+}
+
+static void make_ppg(uint32_t *ir, uint32_t *red, int bpm, double ratio)
+{
+    double phase = 0;
+    for (int n = 0; n < SAMPLES; n++) {
+        phase += bpm / 60.0 * (1 + 0.03 * sin(n / 40.0)) / RATE_HZ;
+        const double ir_dc = 120000 + 800 * sin(n / 400.0);
+        const double red_dc = 90000 + 600 * sin(n / 450.0);
+        const double noise = rand() % 9 - 4;
+        ir[n] = ir_dc + 0.012 * ir_dc * pulse(phase) + noise;
+        red[n] = red_dc + ratio * 0.012 * red_dc * pulse(phase) + noise;
+    }
+}
+
+static bool right(int heart_rate, int spo2, int bpm, int want_spo2)
+{
+    return heart_rate && abs(heart_rate - bpm) <= 0.08 * bpm + 2 && spo2 && abs(spo2 - want_spo2) <= 2;
+}
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+int main(int argc, char **argv)
+{
+    static const int bpms[] = { 48, 60, 72, 90, 110, 140, 170 };
+    static const double ratios[] = { 0.45, 0.6, 0.8, 1.0, 1.2 };
+    static uint32_t ir[SAMPLES], red[SAMPLES];
+    int checks = 0, batch_right = 0, stream_right = 0, spo2_diff_max = 0;
+
+    srand(1);
+    for (size_t b = 0; b < sizeof(bpms) / sizeof(bpms[0]); b++) {
+        for (size_t r = 0; r < sizeof(ratios) / sizeof(ratios[0]); r++) {
+            const int want_spo2 = spo2_from_ratio(lround(ratios[r] * 100));
+            vitals_estimator_t ve;
+            vitals_estimator_init(&ve, RATE_HZ);
+            make_ppg(ir, red, bpms[b], ratios[r]);
+
+            int wrong = 0;
+            for (int n = 0; n < SAMPLES; n++) {
+                vitals_estimator_update(&ve, red[n], ir[n]);
+                if (n < WARMUP || n % RATE_HZ != RATE_HZ - 1) {
+                    continue;
+                }
+                int heart_rate, spo2;
+                batch_vitals(&ir[n + 1 - BATCH_LEN], &red[n + 1 - BATCH_LEN], &heart_rate, &spo2);
+                const bool batch_ok = right(heart_rate, spo2, bpms[b], want_spo2);
+                const bool stream_ok = right(ve.heart_rate, ve.spo2, bpms[b], want_spo2);
+                checks++;
+                batch_right += batch_ok;
+                stream_right += stream_ok;
+                if (batch_ok && stream_ok && abs(spo2 - ve.spo2) > spo2_diff_max) {
+                    spo2_diff_max = abs(spo2 - ve.spo2);
+                }
+                wrong += !stream_ok;
+            }
+            if (wrong) {
+                printf("%d bpm, ratio %.2f: streaming wrong at %d of the checks\n", bpms[b], ratios[r], wrong);
+            }
+        }
+    }
+    printf("%d checks: batch right %d, streaming right %d, SpO2 apart by up to %d where both right\n",
+           checks, batch_right, stream_right, spo2_diff_max);
+
+    int fails = 0;
+    if (stream_right < batch_right || spo2_diff_max > 2) {
+        printf("FAIL: streaming estimator worse than the batch routine\n");
+        fails++;
+    }
+
+    /* No finger on the sensor */
+    vitals_estimator_t ve;
+    vitals_estimator_init(&ve, RATE_HZ);
+    for (int n = 0; n < 300; n++) {
+        vitals_estimator_update(&ve, 500, 800);
+    }
+    if (ve.heart_rate || ve.spo2) {
+        printf("FAIL: no finger reads %d bpm, %d %%\n", ve.heart_rate, ve.spo2);
+        fails++;
+    }
+
+    if (argc > 1 && 0 == strcmp(argv[1], "--bench")) {
+        make_ppg(ir, red, 72, 0.6);
+        int heart_rate = 0, spo2 = 0;
+        double start = now_ns();
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            vitals_estimator_init(&ve, RATE_HZ);
+            for (int n = 0; n < SAMPLES; n++) {
+                vitals_estimator_update(&ve, red[n], ir[n]);
+            }
+        }
+        const double stream_ns = (now_ns() - start) / BENCH_ROUNDS / SAMPLES;
+        start = now_ns();
+        for (int round = 0; round < BENCH_ROUNDS; round++) {
+            for (int n = BATCH_LEN - 1; n < SAMPLES; n += RATE_HZ) {
+                batch_vitals(&ir[n + 1 - BATCH_LEN], &red[n + 1 - BATCH_LEN], &heart_rate, &spo2);
+                __asm__ volatile("" ::"r"(heart_rate), "r"(spo2));
+            }
+        }
+        const double batch_ns = (now_ns() - start) / BENCH_ROUNDS / SAMPLES;
+        printf("ns/sample: batch once a second %.1f, streaming %.1f (%d bpm %d %%)\n", batch_ns, stream_ns,
+               ve.heart_rate, ve.spo2);
+    }
+    return fails ? 1 : 0;
+}
@@ -8,6 +8,7 @@
 #include "bsp/esp-bsp.h"
 #include "esp_log.h"
 #include "esp_check.h"
+#include "audio_mixer.h"
 #include <stdio.h>
 
 static const char *TAG = "app_audio";
@@ -36,27 +37,29 @@ static void audio_callback(audio_player_cb_ctx_t *ctx)
     }
 }
 
-/* Mute wrapper for audio player */
+/* Mute wrapper for audio player: only the stream voice, earcons stay audible */
 static esp_err_t audio_mute_fn(AUDIO_PLAYER_MUTE_SETTING setting)
 {
-    bool mute = (setting == AUDIO_PLAYER_MUTE);
-    return bsp_codec_mute_set(mute);
+    audio_mixer_stream_mute(setting == AUDIO_PLAYER_MUTE);
+    return ESP_OK;
 }
 
-/* Clock config wrapper for audio player */
+/* Clock config wrapper for audio player: the mixer resamples, the codec is left alone */
 static esp_err_t audio_clk_set_fn(uint32_t rate, uint32_t bits_cfg, i2s_slot_mode_t ch)
 {
-    return bsp_codec_set_fs(rate, bits_cfg, ch);
+    return audio_mixer_stream_set_format(rate, bits_cfg, (ch == I2S_SLOT_MODE_MONO) ? 1 : 2);
 }
 
 /* Write wrapper for audio player */
 static esp_err_t audio_write_fn(void *audio_buffer, size_t len, size_t *bytes_written, uint32_t timeout_ms)
 {
-    return bsp_i2s_write(audio_buffer, len, bytes_written, timeout_ms);
+    return audio_mixer_stream_write(audio_buffer, len, bytes_written, timeout_ms);
 }
 
 esp_err_t app_audio_start(void)
 {
+    ESP_RETURN_ON_ERROR(audio_mixer_start(), TAG, "Failed start mixer");
+
     audio_player_config_t config = {
         .mute_fn = audio_mute_fn,
         .clk_set_fn = audio_clk_set_fn,
@@ -89,7 +92,10 @@ esp_err_t app_audio_play(const char *path)
 
 esp_err_t app_audio_stop(void)
 {
-    return audio_player_stop();
+    esp_err_t ret = audio_player_stop();
+    /* Don't let the already mixed-ahead tail play out */
+    audio_mixer_stream_flush();
+    return ret;
 }
 
 esp_err_t app_audio_pause(void)
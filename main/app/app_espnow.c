@@ -1,71 +1,633 @@
+#include <stdio.h>
 #include <string.h>
 #include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
 #include "freertos/task.h"
+#include "esp_check.h"
 #include "esp_log.h"
+#include "esp_random.h"
+#include "esp_timer.h"
 #include "esp_wifi.h"
 #include "esp_now.h"
 #include "esp_netif.h"
 #include "nvs_flash.h"
+#include "nvs.h"
 #include "app_espnow.h"
-#include "app_espnow.h"
+#include "aigis_secure.h"
 #include "app_fall_monitor.h"
 #include "door_ui.h"
 #include "app_audio.h"
 
 static const char *TAG = "app_espnow";
 
-// Remote Node MAC Address (Control Node - NodeMCU)
-static uint8_t remote_mac_control[] = {0xE8, 0xDB, 0x84, 0x11, 0xEF, 0x14};
+#define ESPNOW_TX_QUEUE_LEN     (8)
+#define ESPNOW_TX_TASK_PRIORITY (4)
+#define ESPNOW_TX_MAX           (5)     // Transmissions per command, the first one included
+#define ESPNOW_ACK_TIMEOUT_MS   (20)    // Doubled after every transmission: 20 + 40 + ... + 320 ms in total
+#define ESPNOW_RX_POOL_SIZE     (8)     // Frames received but not yet handled; more are dropped
+#define ESPNOW_RX_TASK_PRIORITY (5)
+#define ESPNOW_PEER_HASH_SIZE   (64)    // Power of two, at least twice APP_ESPNOW_PEER_MAX to keep probes short
+#define ESPNOW_NVS_NAMESPACE    "espnow"
+#define ESPNOW_NVS_PEERS        "links"
+#define ESPNOW_NVS_CTR          "ctr"
+#define ESPNOW_CTR_BLOCK        (1024)  // Send counters reserved per NVS write
+#define ESPNOW_NVS_RX_CTR_FMT   "rx%02x%02x%02x%02x%02x%02x"   // Counter taken from a node, by MAC
+#define ESPNOW_RX_CTR_STEP      (16)    // Receive counter advances per NVS write, and the skip after a reboot
+
+// Nodes pair at run time (AIGIS_MSG_HELLO / AIGIS_MSG_PAIR); the table survives reboots in NVS
+typedef struct {
+    uint8_t mac[6];
+    uint8_t role;                   // aigis_role_t, AIGIS_ROLE_NONE for a free slot
+    uint8_t key[AIGIS_KEY_LEN];     // Link key agreed at pairing
+} espnow_peer_rec_t;
+
+typedef struct {
+    espnow_peer_rec_t rec;
+    uint16_t seq;                   // Last seq sent, only touched by the send task
+    uint32_t rx_ctr;                // Last counter taken from the node, only touched by the receive task
+    uint32_t rx_ctr_saved;          // rx_ctr as last written to NVS (or skipped to at boot), ditto
+    app_espnow_stats_t stats;
+} espnow_peer_t;
+
+static const char *const s_role_name[AIGIS_ROLE_MAX] = {
+    [AIGIS_ROLE_NONE]       = "none",
+    [AIGIS_ROLE_CONTROL]    = "control",
+    [AIGIS_ROLE_DOOR]       = "door",
+    [AIGIS_ROLE_HEALTH]     = "health",
+};
+
+// Slots never move, so a queued command can keep its index; s_peer_hash maps MAC -> slot
+static espnow_peer_t s_peer[APP_ESPNOW_PEER_MAX];
+static int8_t s_peer_hash[ESPNOW_PEER_HASH_SIZE];
+static SemaphoreHandle_t s_peer_lock = NULL;
+static portMUX_TYPE s_stats_lock = portMUX_INITIALIZER_UNLOCKED;
+static int64_t s_pair_until_us = 0;
+static int s_evict_next = 0;
+static uint8_t s_own_mac[6];
+
+// Counters of sealed frames; owned by the send task, NVS holds the end of the reserved block
+static uint32_t s_tx_ctr = 0;
+static uint32_t s_tx_ctr_limit = 0;
+
+// The frame is built by the send task, which owns the sequence numbers
+typedef struct {
+    uint8_t peer;
+    uint8_t role;                   // Role the command was meant for; dropped if the slot was re-paired since
+    uint8_t arg;                    // aigis_command_t or aigis_door_action_t, by role
+} espnow_tx_req_t;
+
+static QueueHandle_t s_tx_que = NULL;
+static TaskHandle_t s_tx_task = NULL;
+
+// Received frames wait in a static pool; the queues carry slot indices, free and filled
+typedef struct {
+    uint8_t mac[6];
+    uint8_t len;
+    uint8_t data[AIGIS_PROTO_MAX_FRAME];
+} espnow_rx_frame_t;
+
+static espnow_rx_frame_t s_rx_pool[ESPNOW_RX_POOL_SIZE];
+static QueueHandle_t s_rx_free_que = NULL;
+static QueueHandle_t s_rx_que = NULL;
+static volatile uint32_t s_rx_dropped = 0;
+
+#define MACSTR_FMT          "%02x:%02x:%02x:%02x:%02x:%02x"
+#define MAC_ARGS(m)         (m)[0], (m)[1], (m)[2], (m)[3], (m)[4], (m)[5]
+
+// FNV-1a over the MAC; the low bits are used, so every byte must reach them
+static uint32_t espnow_mac_hash(const uint8_t *mac)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < 6; i++) {
+        h = (h ^ mac[i]) * 16777619u;
+    }
+    return h;
+}
+
+// Caller holds s_peer_lock
+static int espnow_peer_find(const uint8_t *mac)
+{
+    uint32_t h = espnow_mac_hash(mac);
+    for (int n = 0; n < ESPNOW_PEER_HASH_SIZE; n++, h++) {
+        const int i = s_peer_hash[h & (ESPNOW_PEER_HASH_SIZE - 1)];
+        if (i < 0) {
+            return -1;
+        }
+        if (0 == memcmp(s_peer[i].rec.mac, mac, 6)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Caller holds s_peer_lock. Linear probing has no cheap delete, so unpairing rebuilds
+static void espnow_peer_hash_rebuild(void)
+{
+    memset(s_peer_hash, -1, sizeof(s_peer_hash));
+    for (int i = 0; i < APP_ESPNOW_PEER_MAX; i++) {
+        if (AIGIS_ROLE_NONE == s_peer[i].rec.role) {
+            continue;
+        }
+        uint32_t h = espnow_mac_hash(s_peer[i].rec.mac);
+        while (s_peer_hash[h & (ESPNOW_PEER_HASH_SIZE - 1)] >= 0) {
+            h++;
+        }
+        s_peer_hash[h & (ESPNOW_PEER_HASH_SIZE - 1)] = i;
+    }
+}
+
+// Caller holds s_peer_lock
+static esp_err_t espnow_peer_save(void)
+{
+    espnow_peer_rec_t rec[APP_ESPNOW_PEER_MAX];
+    size_t num = 0;
+    for (int i = 0; i < APP_ESPNOW_PEER_MAX; i++) {
+        if (AIGIS_ROLE_NONE != s_peer[i].rec.role) {
+            rec[num++] = s_peer[i].rec;
+        }
+    }
 
-// Remote Node MAC Address (Health/Fall Node - Xiao C3)
-static const uint8_t remote_mac_health[] = {0x94, 0xA9, 0x90, 0x69, 0x13, 0xF4};
+    nvs_handle_t nvs;
+    ESP_RETURN_ON_ERROR(nvs_open(ESPNOW_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "open NVS failed");
+    esp_err_t ret = num ? nvs_set_blob(nvs, ESPNOW_NVS_PEERS, rec, num * sizeof(rec[0])) : nvs_erase_key(nvs, ESPNOW_NVS_PEERS);
+    if (ESP_OK == ret || ESP_ERR_NVS_NOT_FOUND == ret) {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    ESP_RETURN_ON_ERROR(ret, TAG, "save peers failed");
+    return ESP_OK;
+}
 
-// Remote Node MAC Address (Door Node - ESP32-CAM)
-static const uint8_t remote_mac_door[] = {0x3C, 0x61, 0x05, 0x30, 0x78, 0xF0};
+static void espnow_peer_load(void)
+{
+    espnow_peer_rec_t rec[APP_ESPNOW_PEER_MAX];
+    size_t size = sizeof(rec);
+    nvs_handle_t nvs;
 
-// Callback when data is sent
+    memset(s_peer_hash, -1, sizeof(s_peer_hash));
+    if (ESP_OK != nvs_open(ESPNOW_NVS_NAMESPACE, NVS_READONLY, &nvs)) {
+        ESP_LOGI(TAG, "No paired nodes yet");
+        return;
+    }
+    esp_err_t ret = nvs_get_blob(nvs, ESPNOW_NVS_PEERS, rec, &size);
+    if (ESP_OK != ret) {
+        nvs_close(nvs);
+        ESP_LOGI(TAG, "No paired nodes yet");
+        return;
+    }
+
+    if (size % sizeof(rec[0])) {
+        nvs_close(nvs);
+        ESP_LOGW(TAG, "Peer table has another format, pair the nodes again");
+        return;
+    }
+    for (size_t i = 0; i < size / sizeof(rec[0]); i++) {
+        if (rec[i].role <= AIGIS_ROLE_NONE || rec[i].role >= AIGIS_ROLE_MAX) {
+            continue;
+        }
+        s_peer[i].rec = rec[i];
+        // The node may have gone up to ESPNOW_RX_CTR_STEP past the saved counter before the
+        // reboot; skipping that far refuses replays of those frames, and drops at most that
+        // many fresh ones until the node's counter catches up
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        snprintf(key, sizeof(key), ESPNOW_NVS_RX_CTR_FMT, MAC_ARGS(rec[i].mac));
+        if (ESP_OK == nvs_get_u32(nvs, key, &s_peer[i].rx_ctr)) {
+            s_peer[i].rx_ctr += ESPNOW_RX_CTR_STEP;
+        }
+        s_peer[i].rx_ctr_saved = s_peer[i].rx_ctr;
+        ESP_LOGI(TAG, "Paired %s node " MACSTR_FMT ", counter %lu", s_role_name[rec[i].role], MAC_ARGS(rec[i].mac),
+                 (unsigned long)s_peer[i].rx_ctr);
+    }
+    nvs_close(nvs);
+    espnow_peer_hash_rebuild();
+}
+
+// Called by the receive task when no frame is waiting. A counter is written once it has
+// moved ESPNOW_RX_CTR_STEP past the saved one, so a node sending every 2 s costs a write
+// about every 30 s instead of one per frame
+static void espnow_rx_ctr_save(void)
+{
+    nvs_handle_t nvs;
+    bool opened = false;
+    esp_err_t ret = ESP_OK;
+
+    xSemaphoreTake(s_peer_lock, portMAX_DELAY);
+    for (int i = 0; i < APP_ESPNOW_PEER_MAX && ESP_OK == ret; i++) {
+        espnow_peer_t *peer = &s_peer[i];
+        if (AIGIS_ROLE_NONE == peer->rec.role || peer->rx_ctr - peer->rx_ctr_saved < ESPNOW_RX_CTR_STEP) {
+            continue;
+        }
+        if (!opened) {
+            ret = nvs_open(ESPNOW_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+            if (ESP_OK != ret) {
+                break;
+            }
+            opened = true;
+        }
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        snprintf(key, sizeof(key), ESPNOW_NVS_RX_CTR_FMT, MAC_ARGS(peer->rec.mac));
+        ret = nvs_set_u32(nvs, key, peer->rx_ctr);
+        if (ESP_OK == ret) {
+            peer->rx_ctr_saved = peer->rx_ctr;
+        }
+    }
+    if (opened) {
+        esp_err_t err = nvs_commit(nvs);
+        ret = (ESP_OK == ret) ? err : ret;
+        nvs_close(nvs);
+    }
+    xSemaphoreGive(s_peer_lock);
+    if (ESP_OK != ret) {
+        ESP_LOGW(TAG, "save receive counters failed: %s", esp_err_to_name(ret));
+    }
+}
+
+// A new link key starts the node's counters over; caller holds s_peer_lock
+static void espnow_rx_ctr_forget(const uint8_t *mac)
+{
+    nvs_handle_t nvs;
+    if (ESP_OK == nvs_open(ESPNOW_NVS_NAMESPACE, NVS_READWRITE, &nvs)) {
+        char key[NVS_KEY_NAME_MAX_SIZE];
+        snprintf(key, sizeof(key), ESPNOW_NVS_RX_CTR_FMT, MAC_ARGS(mac));
+        if (ESP_OK == nvs_erase_key(nvs, key)) {
+            nvs_commit(nvs);
+        }
+        nvs_close(nvs);
+    }
+}
+
+// A counter must never repeat under a key, reboots included, so the next block is
+// claimed in NVS before any counter from it is used
+static esp_err_t espnow_ctr_reserve(void)
+{
+    nvs_handle_t nvs;
+    ESP_RETURN_ON_ERROR(nvs_open(ESPNOW_NVS_NAMESPACE, NVS_READWRITE, &nvs), TAG, "open NVS failed");
+    esp_err_t ret = nvs_set_u32(nvs, ESPNOW_NVS_CTR, s_tx_ctr_limit + ESPNOW_CTR_BLOCK);
+    if (ESP_OK == ret) {
+        ret = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    ESP_RETURN_ON_ERROR(ret, TAG, "save counter failed");
+    s_tx_ctr_limit += ESPNOW_CTR_BLOCK;
+    return ESP_OK;
+}
+
+static esp_err_t espnow_ctr_load(void)
+{
+    nvs_handle_t nvs;
+    if (ESP_OK == nvs_open(ESPNOW_NVS_NAMESPACE, NVS_READONLY, &nvs)) {
+        nvs_get_u32(nvs, ESPNOW_NVS_CTR, &s_tx_ctr_limit);
+        nvs_close(nvs);
+    }
+    s_tx_ctr = s_tx_ctr_limit;
+    return espnow_ctr_reserve();
+}
+
+// Make sure ESP-NOW knows the peer before sending to it. Its peer list is smaller than
+// our table, so when it is full another node of ours is taken out; it is added back
+// the next time something is sent to it. Caller holds s_peer_lock
+static esp_err_t espnow_peer_register(const uint8_t *mac)
+{
+    if (esp_now_is_peer_exist(mac)) {
+        return ESP_OK;
+    }
+    esp_now_peer_info_t info = {
+        .channel = 0,               // Current channel
+        .ifidx = WIFI_IF_STA,
+        .encrypt = false,
+    };
+    memcpy(info.peer_addr, mac, 6);
+    esp_err_t ret = esp_now_add_peer(&info);
+    for (int n = 0; ESP_ERR_ESPNOW_FULL == ret && n < APP_ESPNOW_PEER_MAX; n++) {
+        const uint8_t *victim = s_peer[s_evict_next].rec.mac;
+        s_evict_next = (s_evict_next + 1) % APP_ESPNOW_PEER_MAX;
+        if (memcmp(victim, mac, 6) && esp_now_is_peer_exist(victim)) {
+            esp_now_del_peer(victim);
+            ret = esp_now_add_peer(&info);
+        }
+    }
+    return ret;
+}
+
+// An ACK is posted to the send task as its notification value: peer << 16 | seq
+#define ESPNOW_ACK_VALUE(peer, seq) (((uint32_t)(peer) << 16) | (seq))
+
+static bool espnow_wait_ack(uint32_t expect, uint32_t timeout_ms)
+{
+    TimeOut_t timeout;
+    TickType_t wait = pdMS_TO_TICKS(timeout_ms);
+    uint32_t ack;
+
+    vTaskSetTimeOutState(&timeout);
+    while (pdTRUE == xTaskNotifyWait(0, 0, &ack, wait)) {
+        if (ack == expect) {
+            return true;
+        }
+        // Late ACK of an earlier command
+        if (pdTRUE == xTaskCheckForTimeOut(&timeout, &wait)) {
+            break;
+        }
+    }
+    return false;
+}
+
+static void espnow_tx_task(void *pvParam)
+{
+    (void)pvParam;
+    espnow_tx_req_t req;
+    uint8_t plain[AIGIS_PROTO_MAX_FRAME];
+    uint8_t frame[AIGIS_PROTO_MAX_FRAME];
+    uint8_t mac[6];
+    uint8_t key[AIGIS_KEY_LEN];
+
+    while (true) {
+        xQueueReceive(s_tx_que, &req, portMAX_DELAY);
+        espnow_peer_t *peer = &s_peer[req.peer];
+
+        xSemaphoreTake(s_peer_lock, portMAX_DELAY);
+        const bool valid = (req.role == peer->rec.role) && (ESP_OK == espnow_peer_register(peer->rec.mac));
+        memcpy(mac, peer->rec.mac, sizeof(mac));
+        memcpy(key, peer->rec.key, sizeof(key));
+        xSemaphoreGive(s_peer_lock);
+        if (!valid) {
+            ESP_LOGW(TAG, "%s#%d gone, command dropped", s_role_name[req.role], req.peer);
+            continue;
+        }
+
+        const uint16_t seq = ++peer->seq;
+        size_t len = 0;
+        if (AIGIS_ROLE_CONTROL == req.role) {
+            len = aigis_encode_control(plain, sizeof(plain), AIGIS_FLAG_ACK_REQ, seq, req.arg);
+        } else {
+            len = aigis_encode_door(plain, sizeof(plain), AIGIS_FLAG_ACK_REQ, seq, req.arg);
+        }
+
+        const uint32_t expect = ESPNOW_ACK_VALUE(req.peer, seq);
+        const int64_t start = esp_timer_get_time();
+        uint32_t timeout_ms = ESPNOW_ACK_TIMEOUT_MS;
+        uint32_t seal_us = 0;
+        bool acked = false;
+        int tx = 0;
+        while (!acked && tx < ESPNOW_TX_MAX) {
+            // Sealed again for every transmission: a node takes each counter once
+            const int64_t seal_start = esp_timer_get_time();
+            size_t sealed = 0;
+            if (s_tx_ctr < s_tx_ctr_limit || ESP_OK == espnow_ctr_reserve()) {
+                memcpy(frame, plain, len);
+                sealed = aigis_seal(frame, len, sizeof(frame), key, s_own_mac, ++s_tx_ctr);
+            }
+            seal_us += esp_timer_get_time() - seal_start;
+
+            esp_err_t ret = sealed ? esp_now_send(mac, frame, sealed) : ESP_ERR_INVALID_STATE;
+            if (ESP_OK != ret) {
+                ESP_LOGW(TAG, "%s#%d seq %u: send failed: %s", s_role_name[req.role], req.peer, seq, esp_err_to_name(ret));
+            }
+            tx++;
+            acked = espnow_wait_ack(expect, timeout_ms);
+            timeout_ms *= 2;
+        }
+        const uint32_t latency_us = esp_timer_get_time() - start;
+
+        taskENTER_CRITICAL(&s_stats_lock);
+        peer->stats.retries += tx - 1;
+        peer->stats.seal_us_sum += seal_us;
+        if (acked) {
+            peer->stats.delivered++;
+            peer->stats.latency_sum_us += latency_us;
+            if (latency_us > peer->stats.latency_max_us) {
+                peer->stats.latency_max_us = latency_us;
+            }
+        } else {
+            peer->stats.lost++;
+        }
+        taskEXIT_CRITICAL(&s_stats_lock);
+
+        if (acked) {
+            ESP_LOGI(TAG, "%s#%d seq %u acked in %lu us, %d tx, sealing %lu us", s_role_name[req.role], req.peer, seq,
+                     (unsigned long)latency_us, tx, (unsigned long)seal_us);
+        } else {
+            ESP_LOGE(TAG, "%s#%d seq %u lost after %d tx (%lu lost of %lu)", s_role_name[req.role], req.peer, seq, tx,
+                     (unsigned long)peer->stats.lost, (unsigned long)peer->stats.sent);
+        }
+    }
+}
+
+// Queue a command for every node paired with the role
+static esp_err_t espnow_send_reliable(aigis_role_t role, uint8_t arg)
+{
+    ESP_RETURN_ON_FALSE(s_tx_que, ESP_ERR_INVALID_STATE, TAG, "ESP-NOW not initialized");
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+
+    xSemaphoreTake(s_peer_lock, portMAX_DELAY);
+    for (int i = 0; i < APP_ESPNOW_PEER_MAX; i++) {
+        if (role != s_peer[i].rec.role) {
+            continue;
+        }
+        espnow_tx_req_t req = {
+            .peer = i,
+            .role = role,
+            .arg = arg,
+        };
+        const bool queued = (pdTRUE == xQueueSend(s_tx_que, &req, 0));
+
+        taskENTER_CRITICAL(&s_stats_lock);
+        s_peer[i].stats.sent++;
+        s_peer[i].stats.dropped += queued ? 0 : 1;
+        taskEXIT_CRITICAL(&s_stats_lock);
+        if (!queued) {
+            ESP_LOGE(TAG, "%s#%d send queue full", s_role_name[role], i);
+            ret = ESP_ERR_TIMEOUT;
+        } else if (ESP_ERR_NOT_FOUND == ret) {
+            ret = ESP_OK;
+        }
+    }
+    xSemaphoreGive(s_peer_lock);
+
+    if (ESP_ERR_NOT_FOUND == ret) {
+        ESP_LOGW(TAG, "No %s node paired", s_role_name[role]);
+    }
+    return ret;
+}
+
+// Callback when data is sent; delivery is judged by the application ACK, this is the MAC layer only
 static void OnDataSent(const uint8_t *mac_addr, esp_now_send_status_t status) {
-    ESP_LOGI(TAG, "Last Packet Send Status: %s", status == ESP_NOW_SEND_SUCCESS ? "Delivery Success" : "Delivery Fail");
+    ESP_LOGD(TAG, "Last Packet Send Status: %s", status == ESP_NOW_SEND_SUCCESS ? "Delivery Success" : "Delivery Fail");
 }
 
-// Callback when data is received
-static void OnDataRecv(const esp_now_recv_info_t * esp_now_info, const uint8_t *incomingData, int len) {
-    const uint8_t *mac = esp_now_info->src_addr;
-    
-    ESP_LOGI(TAG, "Packet recv from: %02x:%02x:%02x:%02x:%02x:%02x, len: %d", 
-             mac[0], mac[1], mac[2], mac[3], mac[4], mac[5], len);
-
-    if (memcmp(mac, remote_mac_health, 6) == 0) {
-        ESP_LOGI(TAG, "Packet is from Health Node");
-        if (len == sizeof(health_node_data_t)) {
-            health_node_data_t *data = (health_node_data_t *)incomingData;
-            ESP_LOGI(TAG, "Health Data: Fall=%d, Alarm=%d, HR=%f, SpO2=%d", 
-                     data->fallDetected, data->healthAlarm, data->heartRate, data->spo2);
-            app_fall_monitor_process_data(data);
+// A node announcing itself with a fresh public key: while pairing is open, agree a link
+// key with it and answer with ours. Pairing opens only when the user asks for it (BOOT held),
+// never by itself, so the key of a paired node is replaced only then, e.g. after "unpair"
+// on the node; at any other time nobody can take over its slot
+static void espnow_handle_hello(const uint8_t *mac, const aigis_msg_t *msg)
+{
+    const uint8_t role = aigis_get_u8(msg, AIGIS_TAG_ROLE, AIGIS_ROLE_NONE);
+    aigis_tlv_t pub;
+    if (role <= AIGIS_ROLE_NONE || role >= AIGIS_ROLE_MAX
+            || !aigis_tlv_find(msg, AIGIS_TAG_PUBKEY, &pub) || AIGIS_PUBKEY_LEN != pub.len) {
+        ESP_LOGW(TAG, "Bad HELLO from " MACSTR_FMT, MAC_ARGS(mac));
+        return;
+    }
+    if (esp_timer_get_time() > s_pair_until_us) {
+        ESP_LOGW(TAG, "HELLO from %s node " MACSTR_FMT " ignored, pairing is closed", s_role_name[role], MAC_ARGS(mac));
+        return;
+    }
+
+    aigis_keypair_t kp;
+    uint8_t key[AIGIS_KEY_LEN];
+    const int64_t start = esp_timer_get_time();
+    if (!aigis_keypair_gen(&kp) || !aigis_key_derive(&kp, pub.value, key)) {
+        ESP_LOGE(TAG, "Key agreement with " MACSTR_FMT " failed", MAC_ARGS(mac));
+        return;
+    }
+    ESP_LOGI(TAG, "Key agreement took %lu us", (unsigned long)(esp_timer_get_time() - start));
+
+    xSemaphoreTake(s_peer_lock, portMAX_DELAY);
+    int i = espnow_peer_find(mac);
+    if (i >= 0) {
+        ESP_LOGW(TAG, "%s#%d " MACSTR_FMT " paired again, its old key is dropped", s_role_name[s_peer[i].rec.role], i, MAC_ARGS(mac));
+    }
+    for (int n = 0; i < 0 && n < APP_ESPNOW_PEER_MAX; n++) {
+        i = (AIGIS_ROLE_NONE == s_peer[n].rec.role) ? n : -1;
+    }
+    if (i < 0) {
+        xSemaphoreGive(s_peer_lock);
+        ESP_LOGE(TAG, "Peer table full, " MACSTR_FMT " not paired", MAC_ARGS(mac));
+        return;
+    }
+    memcpy(s_peer[i].rec.mac, mac, 6);
+    memcpy(s_peer[i].rec.key, key, sizeof(key));
+    s_peer[i].rec.role = role;
+    s_peer[i].seq = esp_random();
+    s_peer[i].rx_ctr = 0;
+    s_peer[i].rx_ctr_saved = 0;
+    espnow_rx_ctr_forget(mac);
+    memset(&s_peer[i].stats, 0, sizeof(s_peer[i].stats));
+    espnow_peer_hash_rebuild();
+    espnow_peer_save();
+    esp_err_t ret = espnow_peer_register(mac);
+    xSemaphoreGive(s_peer_lock);
+    memset(key, 0, sizeof(key));
+    ESP_LOGI(TAG, "Paired %s node " MACSTR_FMT " as #%d", s_role_name[role], MAC_ARGS(mac), i);
+
+    uint8_t frame[AIGIS_PROTO_HDR_LEN + 2 + AIGIS_PUBKEY_LEN];
+    if (ESP_OK == ret) {
+        ret = esp_now_send(mac, frame, aigis_encode_pair(frame, sizeof(frame), msg->seq, kp.pub));
+    }
+    memset(&kp, 0, sizeof(kp));
+    if (ESP_OK != ret) {
+        ESP_LOGW(TAG, "PAIR to " MACSTR_FMT " failed: %s", MAC_ARGS(mac), esp_err_to_name(ret));
+    }
+}
+
+static void espnow_dispatch(espnow_rx_frame_t *frame)
+{
+    const uint8_t *mac = frame->mac;
+    size_t len = frame->len;
+    aigis_msg_t msg;
+
+    // Only HELLO travels in the clear; everything else must be sealed with the link key
+    if (!aigis_is_sealed(frame->data, len)) {
+        if (aigis_msg_parse(frame->data, len, &msg) && AIGIS_MSG_HELLO == msg.type) {
+            espnow_handle_hello(mac, &msg);
         } else {
-            ESP_LOGW(TAG, "Health Node data len mismatch: %d != %d", len, sizeof(health_node_data_t));
+            ESP_LOGW(TAG, "Plain frame from " MACSTR_FMT " dropped, len: %d", MAC_ARGS(mac), (int)len);
         }
-    } else if (memcmp(mac, remote_mac_control, 6) == 0) {
-        ESP_LOGI(TAG, "Packet from Control Node (ignored)");
-    } else if (memcmp(mac, remote_mac_door, 6) == 0) {
-        ESP_LOGI(TAG, "Packet is from Door Node");
-        if (len == sizeof(door_node_data_recv_t)) {
-             door_node_data_recv_t *data = (door_node_data_recv_t *)incomingData;
-             // Ensure null termination safely
-             char name[33];
-             strncpy(name, data->name, 32);
-             name[32] = '\0';
+        return;
+    }
+
+    uint8_t key[AIGIS_KEY_LEN];
+    xSemaphoreTake(s_peer_lock, portMAX_DELAY);
+    const int i = espnow_peer_find(mac);
+    const aigis_role_t role = (i < 0) ? AIGIS_ROLE_NONE : s_peer[i].rec.role;
+    if (i >= 0) {
+        memcpy(key, s_peer[i].rec.key, sizeof(key));
+    }
+    xSemaphoreGive(s_peer_lock);
+    if (i < 0) {
+        ESP_LOGW(TAG, "Frame from unpaired " MACSTR_FMT, MAC_ARGS(mac));
+        return;
+    }
+
+    uint32_t ctr;
+    len = aigis_open(frame->data, len, key, mac, &ctr);
+    if (!len || ctr <= s_peer[i].rx_ctr || !aigis_msg_parse(frame->data, len, &msg)) {
+        ESP_LOGW(TAG, "Frame from %s#%d rejected: forged, damaged or replayed", s_role_name[role], i);
+        return;
+    }
+    s_peer[i].rx_ctr = ctr;
+
+    if (AIGIS_MSG_ACK == msg.type) {
+        xTaskNotify(s_tx_task, ESPNOW_ACK_VALUE(i, msg.seq), eSetValueWithOverwrite);
+        return;
+    }
+
+    ESP_LOGI(TAG, "Packet recv from %s#%d, type: 0x%02x, len: %d", s_role_name[role], i, msg.type, (int)len);
+
+    if (AIGIS_ROLE_HEALTH == role) {
+        aigis_health_t data;
+        if (AIGIS_MSG_TELEMETRY == msg.type) {
+            aigis_telemetry_t batch;
+            if (aigis_decode_telemetry(&msg, &batch)) {
+                app_fall_monitor_process_telemetry(&batch);
+            }
+        } else if (aigis_decode_health(&msg, &data)) {
+            ESP_LOGI(TAG, "Health Data: Fall=%d, Alarm=%d, HR=%d, SpO2=%d", 
+                     data.fall, data.alarm, data.heart_rate, data.spo2);
+            app_fall_monitor_process_data(&data);
+        } else {
+            ESP_LOGW(TAG, "Unexpected Health Node message 0x%02x", msg.type);
+        }
+    } else if (AIGIS_ROLE_DOOR == role) {
+        char name[AIGIS_NAME_MAX + 1];
+        if (aigis_decode_visitor(&msg, name, sizeof(name))) {
              ESP_LOGI(TAG, "Person Detected: %s", name);
              door_ui_show_person(name);
              app_audio_play("/spiffs/mp3/Someone_at_door_voice.mp3");
         } else {
-             ESP_LOGW(TAG, "Door Node data len mismatch: %d != %d", len, sizeof(door_node_data_recv_t));
+             ESP_LOGW(TAG, "Unexpected Door Node message 0x%02x", msg.type);
         }
     } else {
-        ESP_LOGW(TAG, "Unknown MAC");
+        ESP_LOGI(TAG, "Packet from Control Node (ignored)");
     }
 }
 
+static void espnow_rx_task(void *pvParam)
+{
+    (void)pvParam;
+    uint32_t dropped = 0;
+    uint8_t slot;
+
+    while (true) {
+        xQueueReceive(s_rx_que, &slot, portMAX_DELAY);
+        espnow_dispatch(&s_rx_pool[slot]);
+        xQueueSend(s_rx_free_que, &slot, 0);
+        if (!uxQueueMessagesWaiting(s_rx_que)) {
+            espnow_rx_ctr_save();
+        }
+
+        if (dropped != s_rx_dropped) {
+            dropped = s_rx_dropped;
+            ESP_LOGW(TAG, "Receive pool full, %lu frames dropped so far", (unsigned long)dropped);
+        }
+    }
+}
+
+// Callback when data is received. Runs in the Wi-Fi task: copy the frame out and return,
+// everything else (display lock, SPIFFS, logging) happens in espnow_rx_task
+static void OnDataRecv(const esp_now_recv_info_t * esp_now_info, const uint8_t *incomingData, int len) {
+    uint8_t slot;
+    if (len <= 0 || len > AIGIS_PROTO_MAX_FRAME || pdTRUE != xQueueReceive(s_rx_free_que, &slot, 0)) {
+        s_rx_dropped++;
+        return;
+    }
+    espnow_rx_frame_t *frame = &s_rx_pool[slot];
+    memcpy(frame->mac, esp_now_info->src_addr, sizeof(frame->mac));
+    frame->len = len;
+    memcpy(frame->data, incomingData, len);
+    xQueueSend(s_rx_que, &slot, 0);
+}
+
 esp_err_t app_espnow_init(void) {
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
@@ -103,12 +665,40 @@ esp_err_t app_espnow_init(void) {
     // Log MAC Address for verification
     uint8_t mac_addr[6] = {0};
     ESP_ERROR_CHECK(esp_wifi_get_mac(WIFI_IF_STA, mac_addr));
+    memcpy(s_own_mac, mac_addr, sizeof(s_own_mac));
     ESP_LOGI(TAG, "Device MAC: %02X:%02X:%02X:%02X:%02X:%02X", 
              mac_addr[0], mac_addr[1], mac_addr[2], mac_addr[3], mac_addr[4], mac_addr[5]);
     
     // Low Tx Power to avoid brownout on USB power
     ESP_ERROR_CHECK(esp_wifi_set_max_tx_power(8));
 
+    // Peer table; sequence numbers start at random so a node does not take the first
+    // command after a hub reboot for a duplicate
+    s_peer_lock = xSemaphoreCreateMutex();
+    ESP_RETURN_ON_FALSE(s_peer_lock, ESP_ERR_NO_MEM, TAG, "Failed create peer lock");
+    espnow_peer_load();
+    ESP_RETURN_ON_ERROR(espnow_ctr_load(), TAG, "Failed reserve frame counters");
+    for (int i = 0; i < APP_ESPNOW_PEER_MAX; i++) {
+        s_peer[i].seq = esp_random();
+    }
+    s_tx_que = xQueueCreate(ESPNOW_TX_QUEUE_LEN, sizeof(espnow_tx_req_t));
+    ESP_RETURN_ON_FALSE(s_tx_que, ESP_ERR_NO_MEM, TAG, "Failed create send queue");
+    BaseType_t ret_val = xTaskCreatePinnedToCore(espnow_tx_task, "ESP-NOW TX", 4 * 1024, NULL,
+                         ESPNOW_TX_TASK_PRIORITY, &s_tx_task, tskNO_AFFINITY);
+    ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_FAIL, TAG, "Failed create send task");
+
+    // Receive pipeline; both queues hold every slot, so posting to them never fails.
+    // The receive task also runs the key agreement of pairing, hence its larger stack
+    s_rx_free_que = xQueueCreate(ESPNOW_RX_POOL_SIZE, sizeof(uint8_t));
+    s_rx_que = xQueueCreate(ESPNOW_RX_POOL_SIZE, sizeof(uint8_t));
+    ESP_RETURN_ON_FALSE(s_rx_free_que && s_rx_que, ESP_ERR_NO_MEM, TAG, "Failed create receive queues");
+    for (uint8_t i = 0; i < ESPNOW_RX_POOL_SIZE; i++) {
+        xQueueSend(s_rx_free_que, &i, 0);
+    }
+    ret_val = xTaskCreatePinnedToCore(espnow_rx_task, "ESP-NOW RX", 6 * 1024, NULL,
+                                      ESPNOW_RX_TASK_PRIORITY, NULL, tskNO_AFFINITY);
+    ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_FAIL, TAG, "Failed create receive task");
+
     // Init ESP-NOW
     if (esp_now_init() != ESP_OK) {
         // May already be initialized
@@ -121,71 +711,54 @@ esp_err_t app_espnow_init(void) {
     // Register Recv Callback
     esp_now_register_recv_cb(OnDataRecv);
     
-    // Register Peer (Control Node)
-    esp_now_peer_info_t peerInfo = {};
-    memcpy(peerInfo.peer_addr, remote_mac_control, 6);
-    peerInfo.channel = 0;  
-    peerInfo.encrypt = false;
-    
-    ret = esp_now_add_peer(&peerInfo);
-    if (ret != ESP_OK && ret != ESP_ERR_ESPNOW_EXIST){
-        ESP_LOGE(TAG, "Failed to add peer: %s", esp_err_to_name(ret));
-        return ret;
-    }
-    
-    // Register Peer (Health Node) - Optional, mainly for receiving but good practice if we ever send
-    memset(&peerInfo, 0, sizeof(peerInfo));
-    memcpy(peerInfo.peer_addr, remote_mac_health, 6);
-    peerInfo.channel = 0;
-    peerInfo.encrypt = false;
-    
-    ret = esp_now_add_peer(&peerInfo);
-    if (ret != ESP_OK && ret != ESP_ERR_ESPNOW_EXIST){
-        ESP_LOGW(TAG, "Failed to add health peer (might not be an error if only receiving): %s", esp_err_to_name(ret));
-    }
+    // Paired nodes are registered with ESP-NOW when first sent to. Pairing stays closed until
+    // app_espnow_pair_start(): opening it at every boot would let a spoofed HELLO re-key a
+    // node after any power cut
 
-    // Register Peer (Door Node)
-    memset(&peerInfo, 0, sizeof(peerInfo));
-    memcpy(peerInfo.peer_addr, remote_mac_door, 6);
-    peerInfo.channel = 0; // Same channel
-    peerInfo.encrypt = false;
+    ESP_LOGI(TAG, "ESP-NOW Initialized");
+    return ESP_OK;
+}
 
-    ret = esp_now_add_peer(&peerInfo);
-    if (ret != ESP_OK && ret != ESP_ERR_ESPNOW_EXIST){
-        ESP_LOGE(TAG, "Failed to add door peer: %s", esp_err_to_name(ret));
-    }
+esp_err_t app_espnow_send_command(aigis_command_t command) {
+    ESP_LOGI(TAG, "Send to Control Nodes: %d", command);
+    return espnow_send_reliable(AIGIS_ROLE_CONTROL, command);
+}
 
-    ESP_LOGI(TAG, "ESP-NOW Initialized and Peers Added");
-    return ESP_OK;
+esp_err_t app_espnow_send_door_command(aigis_door_action_t action) {
+    ESP_LOGI(TAG, "Send to Door Nodes: %s", (AIGIS_DOOR_UNLOCK == action) ? "unlock" : "lock");
+    return espnow_send_reliable(AIGIS_ROLE_DOOR, action);
 }
 
-esp_err_t app_espnow_send_command(int command) {
-    control_node_data_t myData;
-    myData.command = command;
-    
-    esp_err_t result = esp_now_send(remote_mac_control, (uint8_t *) &myData, sizeof(myData));
-    
-    if (result == ESP_OK) {
-        ESP_LOGI(TAG, "Sent with success: %d", command);
-        return ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Error sending the data");
-        return ESP_FAIL;
-    }
+void app_espnow_pair_start(uint32_t window_ms) {
+    s_pair_until_us = esp_timer_get_time() + (int64_t)window_ms * 1000;
+    ESP_LOGI(TAG, "Pairing open for %lu s", (unsigned long)(window_ms / 1000));
 }
 
-esp_err_t app_espnow_send_door_command(const char *command) {
-    door_node_data_send_t myData;
-    strncpy(myData.command, command, sizeof(myData.command) - 1);
-    myData.command[sizeof(myData.command) - 1] = '\0';
-    
-    esp_err_t result = esp_now_send(remote_mac_door, (uint8_t *) &myData, sizeof(myData));
-    
-    if (result == ESP_OK) {
-        ESP_LOGI(TAG, "Sent to Door Node: %s", command);
-        return ESP_OK;
-    } else {
-        ESP_LOGE(TAG, "Error sending to Door Node");
-        return ESP_FAIL;
+esp_err_t app_espnow_unpair(const uint8_t mac[6]) {
+    ESP_RETURN_ON_FALSE(mac, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+    xSemaphoreTake(s_peer_lock, portMAX_DELAY);
+    const int i = espnow_peer_find(mac);
+    esp_err_t ret = ESP_ERR_NOT_FOUND;
+    if (i >= 0) {
+        s_peer[i].rec.role = AIGIS_ROLE_NONE;
+        espnow_peer_hash_rebuild();
+        esp_now_del_peer(mac);
+        ret = espnow_peer_save();
+        espnow_rx_ctr_forget(mac);
+        ESP_LOGI(TAG, "Unpaired " MACSTR_FMT, MAC_ARGS(mac));
     }
+    xSemaphoreGive(s_peer_lock);
+    return ret;
+}
+
+esp_err_t app_espnow_get_peer(int index, app_espnow_peer_info_t *info) {
+    ESP_RETURN_ON_FALSE(index >= 0 && index < APP_ESPNOW_PEER_MAX && info, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+    xSemaphoreTake(s_peer_lock, portMAX_DELAY);
+    memcpy(info->mac, s_peer[index].rec.mac, sizeof(info->mac));
+    info->role = s_peer[index].rec.role;
+    taskENTER_CRITICAL(&s_stats_lock);
+    info->stats = s_peer[index].stats;
+    taskEXIT_CRITICAL(&s_stats_lock);
+    xSemaphoreGive(s_peer_lock);
+    return (AIGIS_ROLE_NONE == info->role) ? ESP_ERR_NOT_FOUND : ESP_OK;
 }
@@ -3,61 +3,82 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "esp_err.h"
+#include "aigis_proto.h"
 
-// --- AIGIS SR COMMAND DEFINITIONS ---
-typedef enum {
-    TURN_ON_LIGHT_ONE = 1,
-    TURN_OFF_LIGHT_ONE,
-    TURN_ON_SOCKET,
-    TURN_OFF_SOCKET,
-    TURN_ON_FAN_AT_LEVEL_ONE,
-    TURN_ON_FAN_AT_LEVEL_TWO,
-    TURN_ON_FAN_AT_LEVEL_THREE,
-    TURN_OFF_FAN
-} aigis_command_t;
-
-// Data Structure for Control Node (Light/Fan) - Sending
-typedef struct {
-  int command; 
-} control_node_data_t;
+// Frame format, commands and the health report are shared with the nodes in aigis_proto.h
 
-// Data Structure for Health Node (Fall/Heart) - Receiving
-typedef struct {
-  bool fallDetected;
-  bool healthAlarm;
-  float heartRate;
-  int spo2; 
-} health_node_data_t;
+// Size of the peer table; any mix of node roles, several of each
+#define APP_ESPNOW_PEER_MAX (32)
+
+// Pairing window opened by a long press of the BOOT button
+#define APP_ESPNOW_PAIR_WINDOW_MS (120 * 1000)
 
-// Data Structure for Door Node (ESP32-CAM) - Sending Command
+// Delivery counters of one peer
 typedef struct {
-  char command[16]; 
-} door_node_data_send_t;
+  uint32_t sent;            // Commands handed to the transport
+  uint32_t delivered;       // Commands acknowledged
+  uint32_t lost;            // Commands given up after the last retry
+  uint32_t retries;         // Retransmissions
+  uint32_t dropped;         // Commands rejected because the send queue was full
+  uint32_t latency_max_us;  // Send to ACK, first transmission included
+  uint64_t latency_sum_us;  // Over the delivered commands
+  uint64_t seal_us_sum;     // Encryption time, every transmission included
+} app_espnow_stats_t;
 
-// Data Structure for Door Node (ESP32-CAM) - Receiving Name
+// One paired node
 typedef struct {
-  char name[32];
-} door_node_data_recv_t;
+  uint8_t mac[6];
+  aigis_role_t role;
+  app_espnow_stats_t stats;
+} app_espnow_peer_info_t;
 
 /**
- * @brief Initialize ESP-NOW and register peer
+ * @brief Initialize ESP-NOW and load the paired nodes from NVS. Pairing stays closed.
  * 
  * @return esp_err_t ESP_OK on success
  */
 esp_err_t app_espnow_init(void);
 
 /**
- * @brief Send a command via ESP-NOW to the registered peer
+ * @brief Queue a command for every paired Control Node. It is retransmitted until acknowledged.
  * 
  * @param command The command ID to send
- * @return esp_err_t ESP_OK on success
+ * @return esp_err_t ESP_OK when queued, ESP_ERR_TIMEOUT if the send queue is full,
+ *                   ESP_ERR_NOT_FOUND if no Control Node is paired
  */
-esp_err_t app_espnow_send_command(int command);
+esp_err_t app_espnow_send_command(aigis_command_t command);
 
 /**
- * @brief Send a command via ESP-NOW to the Door Node
+ * @brief Queue a command for every paired Door Node. It is retransmitted until acknowledged.
  * 
- * @param command The command string to send ("lock" or "unlock")
- * @return esp_err_t ESP_OK on success
+ * @param action Lock or unlock
+ * @return esp_err_t ESP_OK when queued, ESP_ERR_TIMEOUT if the send queue is full,
+ *                   ESP_ERR_NOT_FOUND if no Door Node is paired
+ */
+esp_err_t app_espnow_send_door_command(aigis_door_action_t action);
+
+/**
+ * @brief Let nodes pair for a while, on the user's request only. Outside this window HELLO
+ *        is ignored, so the link key of a paired node cannot be replaced by a spoofed one;
+ *        inside it a HELLO from a paired node replaces its key.
+ * 
+ * @param window_ms How long HELLO is accepted
+ */
+void app_espnow_pair_start(uint32_t window_ms);
+
+/**
+ * @brief Forget a paired node
+ * 
+ * @param mac Node MAC
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND if it was not paired
+ */
+esp_err_t app_espnow_unpair(const uint8_t mac[6]);
+
+/**
+ * @brief Get a slot of the peer table
+ * 
+ * @param index 0 to APP_ESPNOW_PEER_MAX - 1
+ * @param info Filled with the node and a consistent copy of its counters
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND for a free slot
  */
-esp_err_t app_espnow_send_door_command(const char *command);
+esp_err_t app_espnow_get_peer(int index, app_espnow_peer_info_t *info);
@@ -9,6 +9,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/param.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/queue.h"
 #include "freertos/event_groups.h"
@@ -17,7 +19,12 @@
 #include "esp_check.h"
 #include "esp_err.h"
 #include "esp_log.h"
+#include "esp_cpu.h"
 #include "app_sr.h"
+#include "audio_interleave.h"
+#include "audio_ring.h"
+#include "sr_recorder.h"
+#include "sr_energy.h"
 
 #include "esp_mn_speech_commands.h"
 #include "esp_process_sdkconfig.h"
@@ -33,6 +40,17 @@
 
 static const char *TAG = "app_sr";
 
+/* Command ids are handed out as uint8_t, 0xFF terminates the index chains */
+#define SR_CMD_NUM_MAX      (ESP_MN_MAX_PHRASE_NUM < 0xFF ? ESP_MN_MAX_PHRASE_NUM : 0xFF)
+#define SR_CMD_NONE         (0xFF)
+#define SR_CMD_HASH_SIZE    (256)
+#define SR_CMD_CAP_INIT     (16)
+
+typedef struct {
+    uint8_t phoneme_next;   /*!< Next command in the same phoneme hash bucket */
+    uint8_t user_next;      /*!< Next command mapped to the same sr_user_cmd_t */
+} sr_cmd_link_t;
+
 typedef struct {
     sr_language_t lang;
     char *mn_name;
@@ -40,17 +58,28 @@ typedef struct {
     const esp_mn_iface_t *multinet;
     const esp_afe_sr_iface_t *afe_handle;
     esp_afe_sr_data_t *afe_data;
-    int16_t *afe_in_buffer;
     int16_t *afe_out_buffer;
-    SLIST_HEAD(sr_cmd_list_t, sr_cmd_t) cmd_list;
+    int feed_chunksize;
+    audio_ring_t *audio_ring;
+    int16_t *capture_drop_buf;
+    sr_audio_stats_t audio_stats;
+    sr_cmd_t *cmd_table;            /*!< Contiguous command table, id == index */
+    sr_cmd_link_t *cmd_link;        /*!< Index chains, parallel to cmd_table */
+    uint16_t cmd_cap;
     uint8_t cmd_num;
+    uint8_t phoneme_head[SR_CMD_HASH_SIZE];
+    uint8_t phoneme_tail[SR_CMD_HASH_SIZE];
+    uint8_t user_head[SR_CMD_MAX];
+    uint8_t user_tail[SR_CMD_MAX];
+    TaskHandle_t capture_task;
     TaskHandle_t feed_task;
     TaskHandle_t detect_task;
     TaskHandle_t handle_task;
     QueueHandle_t result_que;
     EventGroupHandle_t event_group;
 
-    FILE *fp;
+    sr_recorder_t *mic_rec;
+    sr_recorder_t *afe_rec;
     bool b_record_en;
 } sr_data_t;
 
@@ -60,9 +89,26 @@ static srmodel_list_t *models = NULL;
 static sr_data_t *g_sr_data = NULL;
 
 #define I2S_CHANNEL_NUM     (2)
+/**
+ * Feed the AFE the 2-channel I2S data as-is (2 mics, no reference channel)
+ * instead of expanding it to the default 3-channel layout. Only valid while AEC is off.
+ */
+#define SR_FEED_DIRECT_2CH  0
+#define SR_FEED_PROFILE     0 /**< Log the average cycle cost of the channel expansion >*/
+#define SR_FEED_PROFILE_CHUNKS  (512)
+#if SR_FEED_DIRECT_2CH
+#define SR_FEED_CHANNEL_NUM I2S_CHANNEL_NUM
+#else
+#define SR_FEED_CHANNEL_NUM (3)
+#endif
+/* Capture -> feed ring: 16 slots of one feed chunk each (~0.5 s at 16 kHz) */
+#define SR_AUDIO_RING_SLOTS     (16)
+#define SR_AUDIO_RING_CAPS      (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define SR_AUDIO_RING_UNDERRUN_MS   (100)
 #define NEED_DELETE BIT0
 #define FEED_DELETED BIT1
 #define DETECT_DELETED BIT2
+#define CAPTURE_DELETED BIT3
 
 /**
  * @brief all default commands
@@ -70,63 +116,193 @@ static sr_data_t *g_sr_data = NULL;
 static const sr_cmd_t g_default_cmd_info[] = {
     /* English only, minimal command set */
     //light control Smart Home Node
-    {SR_CMD_TURN_ON_LIGHT_ONE, SR_LANG_EN, 0, "turn on light one",  "TkN nN LiT WcN", {NULL}},
-    {SR_CMD_TURN_OFF_LIGHT_ONE, SR_LANG_EN, 0, "turn off light one", "TkN eF LiT WcN", {NULL}},
-    {SR_CMD_TURN_ON_SOCKET, SR_LANG_EN, 0, "turn on socket", "TkN nN SnKcT", {NULL}},
-    {SR_CMD_TURN_OFF_SOCKET, SR_LANG_EN, 0, "turn off socket", "TkN eF SnKcT", {NULL}},
-    {SR_CMD_TURN_ON_FAN_AT_LEVEL_ONE, SR_LANG_EN, 0, "turn on fan at level one", "TkN nN FaN aT LfVcL WcN", {NULL}},
-    {SR_CMD_TURN_ON_FAN_AT_LEVEL_TWO, SR_LANG_EN, 0, "turn on fan at level two", "TkN nN FaN aT LfVcL To", {NULL}},
-    {SR_CMD_TURN_ON_FAN_AT_LEVEL_THREE, SR_LANG_EN, 0, "turn on fan at level three", "TkN nN FaN aT LfVcL vRm", {NULL}},
-    {SR_CMD_TURN_OFF_FAN, SR_LANG_EN, 0, "turn off fan", "TkN eF FaN", {NULL}},
+    {SR_CMD_TURN_ON_LIGHT_ONE, SR_LANG_EN, 0, "turn on light one",  "TkN nN LiT WcN"},
+    {SR_CMD_TURN_OFF_LIGHT_ONE, SR_LANG_EN, 0, "turn off light one", "TkN eF LiT WcN"},
+    {SR_CMD_TURN_ON_SOCKET, SR_LANG_EN, 0, "turn on socket", "TkN nN SnKcT"},
+    {SR_CMD_TURN_OFF_SOCKET, SR_LANG_EN, 0, "turn off socket", "TkN eF SnKcT"},
+    {SR_CMD_TURN_ON_FAN_AT_LEVEL_ONE, SR_LANG_EN, 0, "turn on fan at level one", "TkN nN FaN aT LfVcL WcN"},
+    {SR_CMD_TURN_ON_FAN_AT_LEVEL_TWO, SR_LANG_EN, 0, "turn on fan at level two", "TkN nN FaN aT LfVcL To"},
+    {SR_CMD_TURN_ON_FAN_AT_LEVEL_THREE, SR_LANG_EN, 0, "turn on fan at level three", "TkN nN FaN aT LfVcL vRm"},
+    {SR_CMD_TURN_OFF_FAN, SR_LANG_EN, 0, "turn off fan", "TkN eF FaN"},
     //Health Node
-    {SR_CMD_CHECK_HEALTH, SR_LANG_EN, 0, "check health", "pfK hfLv", {NULL}},
+    {SR_CMD_CHECK_HEALTH, SR_LANG_EN, 0, "check health", "pfK hfLv"},
     //Door Node
-    {SR_CMD_LOCK_THE_DOOR, SR_LANG_EN, 0, "lock the door", "LnK jc DeR", {NULL}},
-    {SR_CMD_UNLOCK_THE_DOOR, SR_LANG_EN, 0, "unlock the door", "cNLnK jc DeR", {NULL}},
+    {SR_CMD_LOCK_THE_DOOR, SR_LANG_EN, 0, "lock the door", "LnK jc DeR"},
+    {SR_CMD_UNLOCK_THE_DOOR, SR_LANG_EN, 0, "unlock the door", "cNLnK jc DeR"},
     //Robot Node
-    {SR_CMD_WALK_FORWARD_AIGIS, SR_LANG_EN, 0, "walk forward", "WeK FeRWkD", {NULL}},
-    {SR_CMD_STOP_AIGIS, SR_LANG_EN, 0, "stop", "STnP", {NULL}},
-    {SR_CMD_LETS_DANCE_AIGIS, SR_LANG_EN, 0, "lets dance", "LfTS DaNS", {NULL}},
-    {SR_CMD_TELL_A_STORY, SR_LANG_EN, 0, "tell a story", "TfL c STeRm", {NULL}},
+    {SR_CMD_WALK_FORWARD_AIGIS, SR_LANG_EN, 0, "walk forward", "WeK FeRWkD"},
+    {SR_CMD_STOP_AIGIS, SR_LANG_EN, 0, "stop", "STnP"},
+    {SR_CMD_LETS_DANCE_AIGIS, SR_LANG_EN, 0, "lets dance", "LfTS DaNS"},
+    {SR_CMD_TELL_A_STORY, SR_LANG_EN, 0, "tell a story", "TfL c STeRm"},
 };
 
-static void audio_feed_task(void *arg)
+static uint32_t sr_cmd_phoneme_hash(const char *phoneme)
 {
-    size_t bytes_read = 0;
-    esp_afe_sr_data_t *afe_data = (esp_afe_sr_data_t *) arg;
-    int audio_chunksize = afe_handle->get_feed_chunksize(afe_data);
-    int feed_channel = 3;
-    ESP_LOGI(TAG, "audio_chunksize=%d, feed_channel=%d", audio_chunksize, feed_channel);
-
-    /* Allocate audio buffer and check for result */
-    int16_t *audio_buffer = heap_caps_malloc(audio_chunksize * sizeof(int16_t) * feed_channel, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
-    if (NULL == audio_buffer) {
-        esp_system_abort("No mem for audio buffer");
+    /* FNV-1a */
+    uint32_t h = 2166136261u;
+    while (*phoneme) {
+        h = (h ^ (uint8_t)*phoneme++) * 16777619u;
+    }
+    return h & (SR_CMD_HASH_SIZE - 1);
+}
+
+/**
+ * @brief Append command `idx` to its phoneme and user command chains, keeping id order
+ */
+static void sr_cmd_index_insert(uint8_t idx)
+{
+    sr_cmd_link_t *link = &g_sr_data->cmd_link[idx];
+    uint32_t bucket = sr_cmd_phoneme_hash(g_sr_data->cmd_table[idx].phoneme);
+    sr_user_cmd_t user_cmd = g_sr_data->cmd_table[idx].cmd;
+
+    link->phoneme_next = SR_CMD_NONE;
+    if (SR_CMD_NONE == g_sr_data->phoneme_head[bucket]) {
+        g_sr_data->phoneme_head[bucket] = idx;
+    } else {
+        g_sr_data->cmd_link[g_sr_data->phoneme_tail[bucket]].phoneme_next = idx;
+    }
+    g_sr_data->phoneme_tail[bucket] = idx;
+
+    link->user_next = SR_CMD_NONE;
+    if (SR_CMD_NONE == g_sr_data->user_head[user_cmd]) {
+        g_sr_data->user_head[user_cmd] = idx;
+    } else {
+        g_sr_data->cmd_link[g_sr_data->user_tail[user_cmd]].user_next = idx;
+    }
+    g_sr_data->user_tail[user_cmd] = idx;
+}
+
+static void sr_cmd_index_rebuild(void)
+{
+    memset(g_sr_data->phoneme_head, SR_CMD_NONE, sizeof(g_sr_data->phoneme_head));
+    memset(g_sr_data->user_head, SR_CMD_NONE, sizeof(g_sr_data->user_head));
+    for (uint8_t i = 0; i < g_sr_data->cmd_num; i++) {
+        sr_cmd_index_insert(i);
+    }
+}
+
+/**
+ * @brief Make room for `num` commands, growing the table geometrically in internal RAM
+ */
+static esp_err_t sr_cmd_table_reserve(uint16_t num)
+{
+    if (num <= g_sr_data->cmd_cap) {
+        return ESP_OK;
+    }
+
+    uint16_t cap = g_sr_data->cmd_cap ? g_sr_data->cmd_cap : SR_CMD_CAP_INIT;
+    while (cap < num) {
+        cap *= 2;
     }
-    g_sr_data->afe_in_buffer = audio_buffer;
+    cap = MIN(cap, SR_CMD_NUM_MAX);
+
+    sr_cmd_t *table = heap_caps_realloc(g_sr_data->cmd_table, cap * sizeof(sr_cmd_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(NULL != table, ESP_ERR_NO_MEM, TAG, "no mem for cmd table");
+    g_sr_data->cmd_table = table;
+
+    sr_cmd_link_t *link = heap_caps_realloc(g_sr_data->cmd_link, cap * sizeof(sr_cmd_link_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(NULL != link, ESP_ERR_NO_MEM, TAG, "no mem for cmd index");
+    g_sr_data->cmd_link = link;
+
+    g_sr_data->cmd_cap = cap;
+    return ESP_OK;
+}
+
+static void audio_capture_task(void *arg)
+{
+    size_t bytes_read = 0;
+    int audio_chunksize = g_sr_data->feed_chunksize;
+    size_t read_len = audio_chunksize * I2S_CHANNEL_NUM * sizeof(int16_t);
+    sr_audio_stats_t *stats = &g_sr_data->audio_stats;
+#if SR_FEED_PROFILE
+    uint32_t prof_cycles = 0;
+    uint32_t prof_chunks = 0;
+#endif
 
     while (true) {
-        if (NEED_DELETE && xEventGroupGetBits(g_sr_data->event_group)) {
-            xEventGroupSetBits(g_sr_data->event_group, FEED_DELETED);
+        if (xEventGroupGetBits(g_sr_data->event_group) & NEED_DELETE) {
+            xEventGroupSetBits(g_sr_data->event_group, CAPTURE_DELETED);
             vTaskDelete(NULL);
         }
 
+        /* Read straight into the next ring slot. If the feed stage has fallen behind,
+         * keep draining I2S into the scratch buffer so the DMA never backs up. */
+        int16_t *audio_buffer = audio_ring_write_acquire(g_sr_data->audio_ring);
+        if (NULL == audio_buffer) {
+            bsp_i2s_read((char *)g_sr_data->capture_drop_buf, read_len, &bytes_read, portMAX_DELAY);
+            stats->overruns++;
+            continue;
+        }
+
         /* Read audio data from I2S bus */
-        bsp_i2s_read((char *)audio_buffer, audio_chunksize * I2S_CHANNEL_NUM * sizeof(int16_t), &bytes_read, portMAX_DELAY);
+        bsp_i2s_read((char *)audio_buffer, read_len, &bytes_read, portMAX_DELAY);
 
-        /* Save audio data to file if record enabled */
-        if (g_sr_data->b_record_en && (NULL != g_sr_data->fp)) {
-            fwrite(audio_buffer, 1, audio_chunksize * I2S_CHANNEL_NUM * sizeof(int16_t), g_sr_data->fp);
+        /* Save audio data to file if record enabled; the detect task clears b_record_en to finish */
+        if (NULL != g_sr_data->mic_rec) {
+            if (g_sr_data->b_record_en) {
+                sr_recorder_write(g_sr_data->mic_rec, audio_buffer, read_len);
+            } else {
+                sr_recorder_close(g_sr_data->mic_rec);
+                g_sr_data->mic_rec = NULL;
+            }
         }
 
+#if !SR_FEED_DIRECT_2CH
         /* Channel Adjust */
-        for (int  i = audio_chunksize - 1; i >= 0; i--) {
-            audio_buffer[i * 3 + 2] = 0;
-            audio_buffer[i * 3 + 1] = audio_buffer[i * 2 + 1];
-            audio_buffer[i * 3 + 0] = audio_buffer[i * 2 + 0];
+#if SR_FEED_PROFILE
+        uint32_t start = esp_cpu_get_cycle_count();
+#endif
+        audio_interleave_2to3(audio_buffer, audio_chunksize);
+#if SR_FEED_PROFILE
+        prof_cycles += esp_cpu_get_cycle_count() - start;
+        if (++prof_chunks == SR_FEED_PROFILE_CHUNKS) {
+            ESP_LOGI(TAG, "channel adjust: %lu cycles/chunk", (unsigned long)(prof_cycles / prof_chunks));
+            prof_cycles = 0;
+            prof_chunks = 0;
+        }
+#endif
+#endif
+        audio_ring_write_commit(g_sr_data->audio_ring);
+        stats->captured++;
+        xTaskNotifyGive(g_sr_data->feed_task);
+    }
+}
+
+static void audio_feed_task(void *arg)
+{
+    esp_afe_sr_data_t *afe_data = (esp_afe_sr_data_t *) arg;
+    sr_audio_stats_t *stats = &g_sr_data->audio_stats;
+    uint32_t last_overruns = 0;
+
+    while (true) {
+        if (xEventGroupGetBits(g_sr_data->event_group) & NEED_DELETE) {
+            xEventGroupSetBits(g_sr_data->event_group, FEED_DELETED);
+            vTaskDelete(NULL);
+        }
+
+        int16_t *audio_buffer = audio_ring_read_acquire(g_sr_data->audio_ring);
+        if (NULL == audio_buffer) {
+            if (0 == ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(SR_AUDIO_RING_UNDERRUN_MS))) {
+                stats->underruns++;
+            }
+            continue;
+        }
+
+        uint32_t fill = audio_ring_count(g_sr_data->audio_ring);
+        if (fill > stats->max_fill) {
+            stats->max_fill = fill;
         }
+
         /* Feed samples of an audio stream to the AFE_SR */
         afe_handle->feed(afe_data, audio_buffer);
+        audio_ring_read_release(g_sr_data->audio_ring);
+        stats->fed++;
+
+        if (stats->overruns != last_overruns) {
+            last_overruns = stats->overruns;
+            ESP_LOGW(TAG, "audio ring overrun: %lu chunks dropped, max fill %lu/%d",
+                     (unsigned long)last_overruns, (unsigned long)stats->max_fill, SR_AUDIO_RING_SLOTS);
+        }
     }
 }
 
@@ -152,6 +328,8 @@ static void audio_detect_task(void *arg)
         if (!res || res->ret_value == ESP_FAIL) {
             continue;
         }
+        /* Overlay bar levels; reads the fetched chunk in place, nothing is copied */
+        sr_energy_update(res->data, afe_chunksize);
 
         if (res->wakeup_state == WAKENET_DETECTED) {
             ESP_LOGI(TAG,  "wakeword detected");
@@ -169,8 +347,8 @@ static void audio_detect_task(void *arg)
 
         if (true == detect_flag) {
             /* Save audio data to file if record enabled */
-            if (g_sr_data->b_record_en && (NULL != g_sr_data->fp)) {
-                fwrite(res->data, 1, afe_chunksize * sizeof(int16_t), g_sr_data->fp);
+            if (NULL != g_sr_data->afe_rec) {
+                sr_recorder_write(g_sr_data->afe_rec, res->data, afe_chunksize * sizeof(int16_t));
             }
 
             esp_mn_state_t mn_state = ESP_MN_STATE_DETECTING;
@@ -217,10 +395,10 @@ static void audio_detect_task(void *arg)
                 detect_flag = false;
 #endif
 
-                if (g_sr_data->b_record_en && (NULL != g_sr_data->fp)) {
-                    ESP_LOGI(TAG, "File saved");
-                    fclose(g_sr_data->fp);
-                    g_sr_data->fp = NULL;
+                if (NULL != g_sr_data->afe_rec) {
+                    sr_recorder_close(g_sr_data->afe_rec);
+                    g_sr_data->afe_rec = NULL;
+                    g_sr_data->b_record_en = false;
                 }
                 continue;
             }
@@ -282,6 +460,33 @@ esp_err_t app_sr_set_language(sr_language_t new_lang)
     return app_sr_update_cmds();/* Reset command list */
 }
 
+/**
+ * @brief Open the raw microphone and AFE output recordings under the first free index
+ */
+static esp_err_t sr_record_open(esp_afe_sr_data_t *afe_data)
+{
+    char file_name[40];
+    struct stat st;
+    int idx = 0;
+    int samp_rate = afe_handle->get_samp_rate(afe_data);
+
+    for (; idx < 100; idx++) {
+        snprintf(file_name, sizeof(file_name), "/sdcard/Record_%02d_mic.wav", idx);
+        if (0 != stat(file_name, &st)) {
+            break;
+        }
+    }
+    ESP_RETURN_ON_ERROR(sr_recorder_open(file_name, samp_rate, I2S_CHANNEL_NUM,
+                                         g_sr_data->feed_chunksize * I2S_CHANNEL_NUM * sizeof(int16_t), &g_sr_data->mic_rec),
+                        TAG, "Failed create mic record");
+
+    snprintf(file_name, sizeof(file_name), "/sdcard/Record_%02d_afe.wav", idx);
+    ESP_RETURN_ON_ERROR(sr_recorder_open(file_name, samp_rate, 1,
+                                         afe_handle->get_fetch_chunksize(afe_data) * sizeof(int16_t), &g_sr_data->afe_rec),
+                        TAG, "Failed create afe record");
+    return ESP_OK;
+}
+
 esp_err_t app_sr_start(bool record_en)
 {
     esp_err_t ret = ESP_OK;
@@ -296,24 +501,8 @@ esp_err_t app_sr_start(bool record_en)
     g_sr_data->event_group = xEventGroupCreate();
     ESP_GOTO_ON_FALSE(NULL != g_sr_data->event_group, ESP_ERR_NO_MEM, err, TAG, "Failed create event_group");
 
-    SLIST_INIT(&g_sr_data->cmd_list);
-
-    /* Create file if record to SD card enabled*/
-    g_sr_data->b_record_en = record_en;
-    if (record_en) {
-        char file_name[32];
-        for (size_t i = 0; i < 100; i++) {
-            sprintf(file_name, "/sdcard/Record_%02d.pcm", i);
-            g_sr_data->fp = fopen(file_name, "r");
-            fclose(g_sr_data->fp);
-            if (NULL == g_sr_data->fp) {
-                break;
-            }
-        }
-        g_sr_data->fp = fopen(file_name, "w");
-        ESP_GOTO_ON_FALSE(NULL != g_sr_data->fp, ESP_FAIL, err, TAG, "Failed create record file");
-        ESP_LOGI(TAG, "File created at %s", file_name);
-    }
+    memset(g_sr_data->phoneme_head, SR_CMD_NONE, sizeof(g_sr_data->phoneme_head));
+    memset(g_sr_data->user_head, SR_CMD_NONE, sizeof(g_sr_data->user_head));
 
     BaseType_t ret_val;
 
@@ -323,6 +512,11 @@ esp_err_t app_sr_start(bool record_en)
 
     afe_config.wakenet_model_name = esp_srmodel_filter(models, ESP_WN_PREFIX, NULL);
     afe_config.aec_init = false;
+#if SR_FEED_DIRECT_2CH
+    afe_config.pcm_config.total_ch_num = I2S_CHANNEL_NUM;
+    afe_config.pcm_config.mic_num = I2S_CHANNEL_NUM;
+    afe_config.pcm_config.ref_num = 0;
+#endif
 
     esp_afe_sr_data_t *afe_data = afe_handle->create_from_config(&afe_config);
     g_sr_data->afe_handle = afe_handle;
@@ -332,9 +526,27 @@ esp_err_t app_sr_start(bool record_en)
     ret = app_sr_set_language(SR_LANG_EN);
     ESP_GOTO_ON_FALSE(ESP_OK == ret, ESP_FAIL, err, TAG,  "Failed to set language");
 
+    g_sr_data->feed_chunksize = afe_handle->get_feed_chunksize(afe_data);
+    ESP_LOGI(TAG, "audio_chunksize=%d, feed_channel=%d", g_sr_data->feed_chunksize, SR_FEED_CHANNEL_NUM);
+    ret = audio_ring_create(SR_AUDIO_RING_SLOTS, g_sr_data->feed_chunksize * SR_FEED_CHANNEL_NUM * sizeof(int16_t),
+                            SR_AUDIO_RING_CAPS, &g_sr_data->audio_ring);
+    ESP_GOTO_ON_ERROR(ret, err, TAG, "Failed create audio ring");
+    g_sr_data->capture_drop_buf = heap_caps_malloc(g_sr_data->feed_chunksize * I2S_CHANNEL_NUM * sizeof(int16_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_GOTO_ON_FALSE(NULL != g_sr_data->capture_drop_buf, ESP_ERR_NO_MEM, err, TAG, "Failed create capture buffer");
+
+    /* Create files if record to SD card enabled */
+    g_sr_data->b_record_en = record_en;
+    if (record_en) {
+        ret = sr_record_open(afe_data);
+        ESP_GOTO_ON_ERROR(ret, err, TAG, "Failed create record files");
+    }
+
     ret_val = xTaskCreatePinnedToCore(&audio_feed_task, "Feed Task", 4 * 1024, (void *)afe_data, 5, &g_sr_data->feed_task, 0);
     ESP_GOTO_ON_FALSE(pdPASS == ret_val, ESP_FAIL, err, TAG,  "Failed create audio feed task");
 
+    ret_val = xTaskCreatePinnedToCore(&audio_capture_task, "Capture Task", 3 * 1024, NULL, 6, &g_sr_data->capture_task, 0);
+    ESP_GOTO_ON_FALSE(pdPASS == ret_val, ESP_FAIL, err, TAG,  "Failed create audio capture task");
+
     ret_val = xTaskCreatePinnedToCore(&audio_detect_task, "Detect Task", 8 * 1024, (void *)afe_data, 5, &g_sr_data->detect_task, 1);
     ESP_GOTO_ON_FALSE(pdPASS == ret_val, ESP_FAIL, err, TAG,  "Failed create audio detect task");
 
@@ -356,7 +568,7 @@ esp_err_t app_sr_stop(void)
      * TODO: A task creation failure cannot be handled correctly now
      * */
     xEventGroupSetBits(g_sr_data->event_group, NEED_DELETE);
-    xEventGroupWaitBits(g_sr_data->event_group, NEED_DELETE | FEED_DELETED | DETECT_DELETED, 1, 1, portMAX_DELAY);
+    xEventGroupWaitBits(g_sr_data->event_group, NEED_DELETE | CAPTURE_DELETED | FEED_DELETED | DETECT_DELETED, 1, 1, portMAX_DELAY);
 
     if (g_sr_data->result_que) {
         vQueueDelete(g_sr_data->result_que);
@@ -368,9 +580,14 @@ esp_err_t app_sr_stop(void)
         g_sr_data->event_group = NULL;
     }
 
-    if (g_sr_data->fp) {
-        fclose(g_sr_data->fp);
-        g_sr_data->fp = NULL;
+    if (g_sr_data->mic_rec) {
+        sr_recorder_close(g_sr_data->mic_rec);
+        g_sr_data->mic_rec = NULL;
+    }
+
+    if (g_sr_data->afe_rec) {
+        sr_recorder_close(g_sr_data->afe_rec);
+        g_sr_data->afe_rec = NULL;
     }
 
     if (g_sr_data->model_data) {
@@ -381,15 +598,18 @@ esp_err_t app_sr_stop(void)
         g_sr_data->afe_handle->destroy(g_sr_data->afe_data);
     }
 
-    sr_cmd_t *it;
-    while (!SLIST_EMPTY(&g_sr_data->cmd_list)) {
-        it = SLIST_FIRST(&g_sr_data->cmd_list);
-        SLIST_REMOVE_HEAD(&g_sr_data->cmd_list, next);
-        heap_caps_free(it);
+    if (g_sr_data->cmd_table) {
+        heap_caps_free(g_sr_data->cmd_table);
+    }
+
+    if (g_sr_data->cmd_link) {
+        heap_caps_free(g_sr_data->cmd_link);
     }
 
-    if (g_sr_data->afe_in_buffer) {
-        heap_caps_free(g_sr_data->afe_in_buffer);
+    audio_ring_delete(g_sr_data->audio_ring);
+
+    if (g_sr_data->capture_drop_buf) {
+        heap_caps_free(g_sr_data->capture_drop_buf);
     }
 
     if (g_sr_data->afe_out_buffer) {
@@ -409,31 +629,29 @@ esp_err_t app_sr_get_result(sr_result_t *result, TickType_t xTicksToWait)
     return ESP_OK;
 }
 
+esp_err_t app_sr_get_audio_stats(sr_audio_stats_t *stats)
+{
+    ESP_RETURN_ON_FALSE(NULL != g_sr_data, ESP_ERR_INVALID_STATE, TAG, "SR is not running");
+    ESP_RETURN_ON_FALSE(NULL != stats, ESP_ERR_INVALID_ARG, TAG, "pointer of stats is invalid");
+
+    *stats = g_sr_data->audio_stats;
+    return ESP_OK;
+}
+
 esp_err_t app_sr_add_cmd(const sr_cmd_t *cmd)
 {
     ESP_RETURN_ON_FALSE(NULL != g_sr_data, ESP_ERR_INVALID_STATE, TAG, "SR is not running");
     ESP_RETURN_ON_FALSE(NULL != cmd, ESP_ERR_INVALID_ARG, TAG, "pointer of cmd is invalid");
     ESP_RETURN_ON_FALSE(cmd->lang == g_sr_data->lang, ESP_ERR_INVALID_ARG, TAG, "cmd lang error");
-    ESP_RETURN_ON_FALSE(ESP_MN_MAX_PHRASE_NUM >= g_sr_data->cmd_num, ESP_ERR_INVALID_STATE, TAG, "cmd is full");
+    ESP_RETURN_ON_FALSE(cmd->cmd < SR_CMD_MAX, ESP_ERR_INVALID_ARG, TAG, "cmd act error");
+    ESP_RETURN_ON_FALSE(SR_CMD_NUM_MAX > g_sr_data->cmd_num, ESP_ERR_INVALID_STATE, TAG, "cmd is full");
+    ESP_RETURN_ON_ERROR(sr_cmd_table_reserve(g_sr_data->cmd_num + 1), TAG, "memory for sr cmd is not enough");
 
-    sr_cmd_t *item = (sr_cmd_t *)heap_caps_calloc(1, sizeof(sr_cmd_t), MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    ESP_RETURN_ON_FALSE(NULL != item, ESP_ERR_NO_MEM, TAG, "memory for sr cmd is not enough");
+    uint8_t idx = g_sr_data->cmd_num;
+    sr_cmd_t *item = &g_sr_data->cmd_table[idx];
     memcpy(item, cmd, sizeof(sr_cmd_t));
-    item->next.sle_next = NULL;
-#if 1 // insert after
-    sr_cmd_t *last = SLIST_FIRST(&g_sr_data->cmd_list);
-    if (last == NULL) {
-        SLIST_INSERT_HEAD(&g_sr_data->cmd_list, item, next);
-    } else {
-        sr_cmd_t *it;
-        while ((it = SLIST_NEXT(last, next)) != NULL) {
-            last = it;
-        }
-        SLIST_INSERT_AFTER(last, item, next);
-    }
-#else  // insert head
-    SLIST_INSERT_HEAD(&g_sr_data->cmd_list, it, next);
-#endif
+    item->id = idx;
+    sr_cmd_index_insert(idx);
 
     if (strstr(g_sr_data->mn_name, "mn6_en")) {
         esp_mn_commands_add(g_sr_data->cmd_num, (char *)cmd->str);
@@ -450,21 +668,18 @@ esp_err_t app_sr_modify_cmd(uint32_t id, const sr_cmd_t *cmd)
     ESP_RETURN_ON_FALSE(NULL != cmd, ESP_ERR_INVALID_ARG, TAG, "pointer of cmd is invalid");
     ESP_RETURN_ON_FALSE(id < g_sr_data->cmd_num, ESP_ERR_INVALID_ARG, TAG, "cmd id out of range");
     ESP_RETURN_ON_FALSE(cmd->lang == g_sr_data->lang, ESP_ERR_INVALID_ARG, TAG, "cmd lang error");
+    ESP_RETURN_ON_FALSE(cmd->cmd < SR_CMD_MAX, ESP_ERR_INVALID_ARG, TAG, "cmd act error");
 
-    sr_cmd_t *it;
-    SLIST_FOREACH(it, &g_sr_data->cmd_list, next) {
-        if (it->id == id) {
-            ESP_LOGI(TAG, "modify cmd [%d] from %s to %s", id, it->str, cmd->str);
-            if (strstr(g_sr_data->mn_name, "mn6_en")) {
-                esp_mn_commands_modify(it->str, (char *)cmd->str);
-            } else {
-                esp_mn_commands_modify(it->phoneme, (char *)cmd->phoneme);
-            }
-            memcpy(it, cmd, sizeof(sr_cmd_t));
-            break;
-        }
+    sr_cmd_t *it = &g_sr_data->cmd_table[id];
+    ESP_LOGI(TAG, "modify cmd [%d] from %s to %s", id, it->str, cmd->str);
+    if (strstr(g_sr_data->mn_name, "mn6_en")) {
+        esp_mn_commands_modify(it->str, (char *)cmd->str);
+    } else {
+        esp_mn_commands_modify(it->phoneme, (char *)cmd->phoneme);
     }
-    ESP_RETURN_ON_FALSE(NULL != it, ESP_ERR_NOT_FOUND, TAG, "can't find cmd id:%d", cmd->id);
+    memcpy(it, cmd, sizeof(sr_cmd_t));
+    it->id = id;
+    sr_cmd_index_rebuild();
     return ESP_OK;
 }
 
@@ -472,30 +687,22 @@ esp_err_t app_sr_remove_cmd(uint32_t id)
 {
     ESP_RETURN_ON_FALSE(NULL != g_sr_data, ESP_ERR_INVALID_STATE, TAG, "SR is not running");
     ESP_RETURN_ON_FALSE(id < g_sr_data->cmd_num, ESP_ERR_INVALID_ARG, TAG, "cmd id out of range");
-    sr_cmd_t *it;
-    SLIST_FOREACH(it, &g_sr_data->cmd_list, next) {
-        if (it->id == id) {
-            ESP_LOGI(TAG, "remove cmd id [%d]", it->id);
-            SLIST_REMOVE(&g_sr_data->cmd_list, it, sr_cmd_t, next);
-            heap_caps_free(it);
-            g_sr_data->cmd_num--;
-            break;
-        }
+
+    ESP_LOGI(TAG, "remove cmd id [%d]", id);
+    g_sr_data->cmd_num--;
+    memmove(&g_sr_data->cmd_table[id], &g_sr_data->cmd_table[id + 1], (g_sr_data->cmd_num - id) * sizeof(sr_cmd_t));
+    for (uint32_t i = id; i < g_sr_data->cmd_num; i++) {
+        g_sr_data->cmd_table[i].id = i;
     }
-    ESP_RETURN_ON_FALSE(NULL != it, ESP_ERR_NOT_FOUND, TAG, "can't find cmd id:%d", id);
+    sr_cmd_index_rebuild();
     return ESP_OK;
 }
 
 esp_err_t app_sr_remove_all_cmd(void)
 {
     ESP_RETURN_ON_FALSE(NULL != g_sr_data, ESP_ERR_INVALID_STATE, TAG, "SR is not running");
-    sr_cmd_t *it;
-    while (!SLIST_EMPTY(&g_sr_data->cmd_list)) {
-        it = SLIST_FIRST(&g_sr_data->cmd_list);
-        SLIST_REMOVE_HEAD(&g_sr_data->cmd_list, next);
-        heap_caps_free(it);
-    }
-    SLIST_INIT(&g_sr_data->cmd_list);
+    g_sr_data->cmd_num = 0;
+    sr_cmd_index_rebuild();
     return ESP_OK;
 }
 
@@ -503,12 +710,6 @@ esp_err_t app_sr_update_cmds(void)
 {
     ESP_RETURN_ON_FALSE(NULL != g_sr_data, ESP_ERR_INVALID_STATE, TAG, "SR is not running");
 
-    uint32_t count = 0;
-    sr_cmd_t *it;
-    SLIST_FOREACH(it, &g_sr_data->cmd_list, next) {
-        it->id = count++;
-    }
-
     esp_mn_error_t *err_id = esp_mn_commands_update(g_sr_data->multinet, g_sr_data->model_data);
     if (err_id) {
         for (int i = 0; i < err_id->num; i++) {
@@ -523,17 +724,15 @@ esp_err_t app_sr_update_cmds(void)
 uint8_t app_sr_search_cmd_from_user_cmd(sr_user_cmd_t user_cmd, uint8_t *id_list, uint16_t max_len)
 {
     ESP_RETURN_ON_FALSE(NULL != g_sr_data, 0, TAG, "SR is not running");
+    ESP_RETURN_ON_FALSE(user_cmd < SR_CMD_MAX, 0, TAG, "user cmd out of range");
 
     uint8_t cmd_num = 0;
-    sr_cmd_t *it;
-    SLIST_FOREACH(it, &g_sr_data->cmd_list, next) {
-        if (user_cmd == it->cmd) {
-            if (id_list) {
-                id_list[cmd_num] = it->id;
-            }
-            if (++cmd_num >= max_len) {
-                break;
-            }
+    for (uint8_t i = g_sr_data->user_head[user_cmd]; i != SR_CMD_NONE; i = g_sr_data->cmd_link[i].user_next) {
+        if (id_list) {
+            id_list[cmd_num] = i;
+        }
+        if (++cmd_num >= max_len) {
+            break;
         }
     }
     return cmd_num;
@@ -544,11 +743,11 @@ uint8_t app_sr_search_cmd_from_phoneme(const char *phoneme, uint8_t *id_list, ui
     ESP_RETURN_ON_FALSE(NULL != g_sr_data, 0, TAG, "SR is not running");
 
     uint8_t cmd_num = 0;
-    sr_cmd_t *it;
-    SLIST_FOREACH(it, &g_sr_data->cmd_list, next) {
-        if (0 == strcmp(phoneme, it->phoneme)) {
+    uint32_t bucket = sr_cmd_phoneme_hash(phoneme);
+    for (uint8_t i = g_sr_data->phoneme_head[bucket]; i != SR_CMD_NONE; i = g_sr_data->cmd_link[i].phoneme_next) {
+        if (0 == strcmp(phoneme, g_sr_data->cmd_table[i].phoneme)) {
             if (id_list) {
-                id_list[cmd_num] = it->id;
+                id_list[cmd_num] = i;
             }
             if (++cmd_num >= max_len) {
                 break;
@@ -563,12 +762,5 @@ const sr_cmd_t *app_sr_get_cmd_from_id(uint32_t id)
     ESP_RETURN_ON_FALSE(NULL != g_sr_data, NULL, TAG, "SR is not running");
     ESP_RETURN_ON_FALSE(id < g_sr_data->cmd_num, NULL, TAG, "cmd id out of range");
 
-    sr_cmd_t *it;
-    SLIST_FOREACH(it, &g_sr_data->cmd_list, next) {
-        if (id == it->id) {
-            return it;
-        }
-    }
-    ESP_RETURN_ON_FALSE(NULL != it, NULL, TAG, "can't find cmd id:%d", id);
-    return NULL;
+    return &g_sr_data->cmd_table[id];
 }
@@ -7,7 +7,6 @@
 #pragma once
 
 #include <stdbool.h>
-#include <sys/queue.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "esp_err.h"
@@ -85,12 +84,23 @@ typedef struct sr_cmd_t {
     uint32_t id;
     char str[SR_CMD_STR_LEN_MAX];
     char phoneme[SR_CMD_PHONEME_LEN_MAX];
-    SLIST_ENTRY(sr_cmd_t) next;
 } sr_cmd_t;
 
+/**
+ * @brief Counters of the I2S capture -> AFE feed pipeline, in chunks
+ */
+typedef struct {
+    uint32_t captured;  /*!< Chunks read from I2S into the ring */
+    uint32_t fed;       /*!< Chunks fed to the AFE */
+    uint32_t overruns;  /*!< Chunks dropped because the ring was full */
+    uint32_t underruns; /*!< Feed waits that timed out on an empty ring */
+    uint32_t max_fill;  /*!< High-water mark of filled ring slots */
+} sr_audio_stats_t;
+
 esp_err_t app_sr_start(bool record_en);
 esp_err_t app_sr_stop(void);
 esp_err_t app_sr_get_result(sr_result_t *result, TickType_t xTicksToWait);
+esp_err_t app_sr_get_audio_stats(sr_audio_stats_t *stats);
 esp_err_t app_sr_set_language(sr_language_t new_lang);
 esp_err_t app_sr_add_cmd(const sr_cmd_t *cmd);
 esp_err_t app_sr_modify_cmd(uint32_t id, const sr_cmd_t *cmd);
@@ -0,0 +1,182 @@
+/*
+ * SR Action: executes the action list bound to a recognized command.
+ */
+
+#include "app_sr_action.h"
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "app_espnow.h"
+#include "app_uart.h"
+#include "app_audio.h"
+#include "app_fall_monitor.h"
+#include "ui_sr.h"
+#include "main_ui.h"
+#include "door_ui.h"
+#include "dance_ui.h"
+#include "story_ui.h"
+
+static const char *TAG = "sr_action";
+
+#define SR_ACTION_QUEUE_LEN     (4)
+#define SR_ACTION_TASK_PRIORITY (5)
+
+static QueueHandle_t s_action_que = NULL;
+
+/* Screen shown by a timed SR_ACTION_UI step, and when to leave it */
+static bool s_hold_active = false;
+static sr_ui_screen_t s_hold_screen;
+static TickType_t s_hold_until;
+
+static void sr_action_show_ui(sr_ui_screen_t screen)
+{
+    switch (screen) {
+    case SR_UI_MAIN:
+        dance_ui_show(false);
+        story_ui_show(false);
+        main_ui_show(true);
+        break;
+    case SR_UI_DOOR_LOCKED:
+    case SR_UI_DOOR_UNLOCKED:
+        main_ui_show(false);
+        door_ui_show(true);
+        door_ui_set(SR_UI_DOOR_LOCKED == screen);
+        break;
+    case SR_UI_DANCE:
+        main_ui_show(false);
+        door_ui_show(false);
+        dance_ui_show(true);
+        break;
+    case SR_UI_STORY:
+        main_ui_show(false);
+        door_ui_show(false);
+        dance_ui_show(false);
+        story_ui_show(true);
+        break;
+    }
+}
+
+static void sr_action_leave_ui(sr_ui_screen_t screen)
+{
+    switch (screen) {
+    case SR_UI_DOOR_LOCKED:
+    case SR_UI_DOOR_UNLOCKED:
+        door_ui_show(false);
+        break;
+    case SR_UI_DANCE:
+        dance_ui_show(false);
+        break;
+    case SR_UI_STORY:
+        story_ui_show(false);
+        break;
+    case SR_UI_MAIN:
+        break;
+    }
+    main_ui_show(true);
+}
+
+static void sr_action_exec(const sr_action_t *act)
+{
+    switch (act->type) {
+    case SR_ACTION_ESPNOW:
+        app_espnow_send_command((aigis_command_t)act->arg);
+        break;
+    case SR_ACTION_DOOR:
+        app_espnow_send_door_command((aigis_door_action_t)act->arg);
+        break;
+    case SR_ACTION_UART:
+        app_uart_send_cmd((char)act->arg);
+        break;
+    case SR_ACTION_TEXT:
+        sr_anim_set_text((char *)act->str);
+        break;
+    case SR_ACTION_UI:
+        sr_action_show_ui((sr_ui_screen_t)act->arg);
+        if (act->ms) {
+            s_hold_active = true;
+            s_hold_screen = (sr_ui_screen_t)act->arg;
+            s_hold_until = xTaskGetTickCount() + pdMS_TO_TICKS(act->ms);
+        }
+        break;
+    case SR_ACTION_STOP_ALARM:
+        app_fall_monitor_stop_alarm();
+        break;
+    case SR_ACTION_PLAY:
+        if (act->arg) {
+            app_audio_volume_set(act->arg);
+        }
+        app_audio_play(act->str);
+        break;
+    default:
+        ESP_LOGW(TAG, "Unknown action %d", act->type);
+        break;
+    }
+}
+
+static void sr_action_task(void *pvParam)
+{
+    (void)pvParam;
+    const sr_action_t *actions;
+
+    while (true) {
+        TickType_t wait = portMAX_DELAY;
+        if (s_hold_active) {
+            TickType_t now = xTaskGetTickCount();
+            wait = ((int32_t)(s_hold_until - now) > 0) ? s_hold_until - now : 0;
+        }
+
+        if (pdTRUE != xQueueReceive(s_action_que, &actions, wait)) {
+            /* Hold expired without a newer command */
+            ESP_LOGI(TAG, "Screen %d timed out, back to main", s_hold_screen);
+            s_hold_active = false;
+            sr_action_leave_ui(s_hold_screen);
+            continue;
+        }
+
+        /* A new screen supersedes any pending return to the main screen; other commands leave the timer running */
+        for (const sr_action_t *act = actions; act->type != SR_ACTION_END; act++) {
+            if (SR_ACTION_UI == act->type) {
+                s_hold_active = false;
+                break;
+            }
+        }
+        for (const sr_action_t *act = actions; act->type != SR_ACTION_END; act++) {
+            sr_action_exec(act);
+        }
+    }
+}
+
+esp_err_t app_sr_action_init(void)
+{
+    if (s_action_que) {
+        return ESP_OK;
+    }
+
+    s_action_que = xQueueCreate(SR_ACTION_QUEUE_LEN, sizeof(const sr_action_t *));
+    ESP_RETURN_ON_FALSE(s_action_que, ESP_ERR_NO_MEM, TAG, "Failed create action queue");
+
+    BaseType_t ret_val = xTaskCreatePinnedToCore(sr_action_task, "SR Action", 4 * 1024, NULL, SR_ACTION_TASK_PRIORITY, NULL, 0);
+    if (pdPASS != ret_val) {
+        vQueueDelete(s_action_que);
+        s_action_que = NULL;
+        ESP_LOGE(TAG, "Failed create action task");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
+}
+
+esp_err_t app_sr_action_run(const sr_action_t *actions)
+{
+    ESP_RETURN_ON_FALSE(actions, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+    ESP_RETURN_ON_FALSE(s_action_que, ESP_ERR_INVALID_STATE, TAG, "action task not started");
+
+    if (pdTRUE != xQueueSend(s_action_que, &actions, 0)) {
+        ESP_LOGW(TAG, "Action queue full, command dropped");
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
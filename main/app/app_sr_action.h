@@ -0,0 +1,74 @@
+/*
+ * SR Action: executes the action list bound to a recognized command.
+ *
+ * Action lists are static, SR_ACT_END-terminated arrays. app_sr_action_run() only
+ * queues the list, so the SR handler goes straight back to waiting for results;
+ * a worker task runs the steps and owns the "show this screen for N ms" timers.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SR_ACTION_END = 0,      /*!< Terminates an action list */
+    SR_ACTION_ESPNOW,       /*!< Send command `arg` to the Smart Home Node */
+    SR_ACTION_DOOR,         /*!< Send aigis_door_action_t `arg` to the Door Node */
+    SR_ACTION_UART,         /*!< Send character `arg` to the Nano */
+    SR_ACTION_TEXT,         /*!< Set the SR overlay text to `str` */
+    SR_ACTION_UI,           /*!< Switch to screen `arg`; return to the main screen after `ms` if non-zero */
+    SR_ACTION_STOP_ALARM,   /*!< Silence the fall alarm */
+    SR_ACTION_PLAY,         /*!< Stream the MP3 clip at `str`, at volume `arg` if non-zero; leaving its screen stops it */
+} sr_action_type_t;
+
+typedef enum {
+    SR_UI_MAIN,
+    SR_UI_DOOR_LOCKED,
+    SR_UI_DOOR_UNLOCKED,
+    SR_UI_DANCE,
+    SR_UI_STORY,
+} sr_ui_screen_t;
+
+typedef struct {
+    sr_action_type_t type;
+    int arg;
+    const char *str;
+    uint32_t ms;
+} sr_action_t;
+
+#define SR_ACT_END                  {.type = SR_ACTION_END}
+#define SR_ACT_ESPNOW(cmd)          {.type = SR_ACTION_ESPNOW, .arg = (cmd)}
+#define SR_ACT_DOOR(action)         {.type = SR_ACTION_DOOR, .arg = (action)}
+#define SR_ACT_UART(c)              {.type = SR_ACTION_UART, .arg = (c)}
+#define SR_ACT_TEXT(text)           {.type = SR_ACTION_TEXT, .str = (text)}
+#define SR_ACT_UI(screen)           {.type = SR_ACTION_UI, .arg = (screen)}
+#define SR_ACT_UI_FOR(screen, t)    {.type = SR_ACTION_UI, .arg = (screen), .ms = (t)}
+#define SR_ACT_STOP_ALARM           {.type = SR_ACTION_STOP_ALARM}
+#define SR_ACT_PLAY(path, volume)   {.type = SR_ACTION_PLAY, .str = (path), .arg = (volume)}
+
+/**
+ * @brief Start the action worker task. Safe to call more than once.
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t app_sr_action_init(void);
+
+/**
+ * @brief Queue an action list for execution. Never blocks.
+ *
+ * A pending timed screen from an earlier list is cancelled when this list switches screens;
+ * otherwise it still returns to the main screen on time.
+ *
+ * @param actions SR_ACT_END-terminated list with static storage
+ * @return esp_err_t ESP_OK if queued, ESP_ERR_TIMEOUT if the queue is full
+ */
+esp_err_t app_sr_action_run(const sr_action_t *actions);
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,22 +18,72 @@
 
 #include "app_sr.h"
 #include "app_sr_handler.h"
-#include "app_uart.h"
+#include "app_sr_action.h"
 #include "app_espnow.h"
+#include "audio_mixer.h"
+#include "earcon_cache.h"
 
 #include "ui_sr.h"
-#include "main_ui.h"
-#include "door_ui.h"
 #include "dance_ui.h"
 #include "story_ui.h"
-#include "fall_ui.h"
-#include "app_fall_monitor.h"
-#include "app_audio.h"
 
 
 static const char *TAG = "sr_handler";
 
-static bool s_audio_playing = false;
+
+#define SR_DOOR_UI_HOLD_MS  (3000)
+#define SR_CLIP_VOLUME      (80)
+
+/* What each command does once recognized; commands without an entry only get the OK tone */
+static const sr_action_t *const s_cmd_actions[SR_CMD_MAX] = {
+    /* Smart Home Node */
+    [SR_CMD_TURN_ON_LIGHT_ONE] = (const sr_action_t[]) { SR_ACT_ESPNOW(TURN_ON_LIGHT_ONE), SR_ACT_END },
+    [SR_CMD_TURN_OFF_LIGHT_ONE] = (const sr_action_t[]) { SR_ACT_ESPNOW(TURN_OFF_LIGHT_ONE), SR_ACT_END },
+    [SR_CMD_TURN_ON_SOCKET] = (const sr_action_t[]) { SR_ACT_ESPNOW(TURN_ON_SOCKET), SR_ACT_END },
+    [SR_CMD_TURN_OFF_SOCKET] = (const sr_action_t[]) { SR_ACT_ESPNOW(TURN_OFF_SOCKET), SR_ACT_END },
+    [SR_CMD_TURN_ON_FAN_AT_LEVEL_ONE] = (const sr_action_t[]) { SR_ACT_ESPNOW(TURN_ON_FAN_AT_LEVEL_ONE), SR_ACT_END },
+    [SR_CMD_TURN_ON_FAN_AT_LEVEL_TWO] = (const sr_action_t[]) { SR_ACT_ESPNOW(TURN_ON_FAN_AT_LEVEL_TWO), SR_ACT_END },
+    [SR_CMD_TURN_ON_FAN_AT_LEVEL_THREE] = (const sr_action_t[]) { SR_ACT_ESPNOW(TURN_ON_FAN_AT_LEVEL_THREE), SR_ACT_END },
+    [SR_CMD_TURN_OFF_FAN] = (const sr_action_t[]) { SR_ACT_ESPNOW(TURN_OFF_FAN), SR_ACT_END },
+
+    /* Door Node: show the door state for a while, then return to the main face */
+    [SR_CMD_LOCK_THE_DOOR] = (const sr_action_t[]) {
+        SR_ACT_DOOR(AIGIS_DOOR_LOCK),
+        SR_ACT_UI_FOR(SR_UI_DOOR_LOCKED, SR_DOOR_UI_HOLD_MS),
+        SR_ACT_END
+    },
+    [SR_CMD_UNLOCK_THE_DOOR] = (const sr_action_t[]) {
+        SR_ACT_DOOR(AIGIS_DOOR_UNLOCK),
+        SR_ACT_UI_FOR(SR_UI_DOOR_UNLOCKED, SR_DOOR_UI_HOLD_MS),
+        SR_ACT_END
+    },
+
+    /* Robot */
+    [SR_CMD_WALK_FORWARD_AIGIS] = (const sr_action_t[]) { SR_ACT_UART('F'), SR_ACT_END },
+    [SR_CMD_STOP_AIGIS] = (const sr_action_t[]) {
+        SR_ACT_TEXT("Stopped"),
+        SR_ACT_UART('H'),
+        SR_ACT_STOP_ALARM,
+        SR_ACT_UI(SR_UI_MAIN),
+        SR_ACT_END
+    },
+    [SR_CMD_LETS_DANCE_AIGIS] = (const sr_action_t[]) {
+        SR_ACT_TEXT("Dancing..."),
+        SR_ACT_UART('D'),
+        SR_ACT_UI(SR_UI_DANCE),
+        SR_ACT_PLAY("/spiffs/mp3/Dance with Me.mp3", SR_CLIP_VOLUME),
+        SR_ACT_END
+    },
+    [SR_CMD_TELL_A_STORY] = (const sr_action_t[]) {
+        SR_ACT_TEXT("Story Time"),
+        SR_ACT_UI(SR_UI_STORY),
+        SR_ACT_PLAY("/spiffs/mp3/Short_Story.mp3", SR_CLIP_VOLUME),
+        SR_ACT_END
+    },
+
+    /* Health Node: no action yet, but a known command, so it is not logged as unhandled */
+    [SR_CMD_CHECK_HEALTH] = (const sr_action_t[]) { SR_ACT_END },
+};
 
 typedef enum {
     AUDIO_WAKE,
@@ -42,108 +92,33 @@ typedef enum {
     AUDIO_MAX,
 } audio_segment_t;
 
-typedef struct {
-    uint8_t *buf;
-    size_t len;
-} audio_data_t;
-
-static audio_data_t s_audio[AUDIO_MAX];
-
-static esp_err_t load_wav_to_mem(audio_segment_t seg, const char *path)
-{
-    FILE *fp = fopen(path, "rb");
-    if (!fp) {
-        return ESP_ERR_NOT_FOUND;
-    }
-    fseek(fp, 0, SEEK_END);
-    long sz = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    if (sz <= 0) {
-        fclose(fp);
-        return ESP_FAIL;
-    }
-
-    if (s_audio[seg].buf) {
-        heap_caps_free(s_audio[seg].buf);
-        s_audio[seg].buf = NULL;
-        s_audio[seg].len = 0;
-    }
-
-    s_audio[seg].len = (size_t)sz;
-    s_audio[seg].buf = heap_caps_malloc(s_audio[seg].len, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
-    if (!s_audio[seg].buf) {
-        fclose(fp);
-        return ESP_ERR_NO_MEM;
-    }
-    fread(s_audio[seg].buf, 1, s_audio[seg].len, fp);
-    fclose(fp);
-    return ESP_OK;
-}
+/* The SR feedback tones stay out of the action table: they answer the wake word and timeouts
+ * as well as commands, and are handed to the mixer right here, without a hop through the queue */
+static earcon_t s_earcon[AUDIO_MAX];
 
 static esp_err_t sr_echo_init(void)
 {
-    /* English only */
+    /* English only; wake first so the most latency-critical tone gets internal RAM */
     ESP_LOGI(TAG, "Loading SR echo wavs from SPIFFS");
-    ESP_RETURN_ON_ERROR(load_wav_to_mem(AUDIO_WAKE, "/spiffs/echo_en_wake.wav"), TAG, "load wake wav failed");
-    ESP_RETURN_ON_ERROR(load_wav_to_mem(AUDIO_OK, "/spiffs/echo_en_ok.wav"), TAG, "load ok wav failed");
-    ESP_RETURN_ON_ERROR(load_wav_to_mem(AUDIO_END, "/spiffs/echo_en_end.wav"), TAG, "load end wav failed");
-    ESP_LOGI(TAG, "SR echo wavs loaded: wake=%u bytes, ok=%u bytes, end=%u bytes",
-             (unsigned)s_audio[AUDIO_WAKE].len,
-             (unsigned)s_audio[AUDIO_OK].len,
-             (unsigned)s_audio[AUDIO_END].len);
+    ESP_RETURN_ON_ERROR(earcon_cache_load("/spiffs/echo_en_wake.wav", &s_earcon[AUDIO_WAKE]), TAG, "load wake wav failed");
+    ESP_RETURN_ON_ERROR(earcon_cache_load("/spiffs/echo_en_ok.wav", &s_earcon[AUDIO_OK]), TAG, "load ok wav failed");
+    ESP_RETURN_ON_ERROR(earcon_cache_load("/spiffs/echo_en_end.wav", &s_earcon[AUDIO_END]), TAG, "load end wav failed");
     return ESP_OK;
 }
 
 static esp_err_t sr_echo_play(audio_segment_t seg)
 {
-    typedef struct {
-        uint8_t ChunkID[4];
-        int32_t ChunkSize;
-        uint8_t Format[4];
-        uint8_t Subchunk1ID[4];
-        int32_t Subchunk1Size;
-        int16_t AudioFormat;
-        int16_t NumChannels;
-        int32_t SampleRate;
-        int32_t ByteRate;
-        int16_t BlockAlign;
-        int16_t BitsPerSample;
-        uint8_t Subchunk2ID[4];
-        int32_t Subchunk2Size;
-    } wav_header_t;
-
-    if (!s_audio[seg].buf || s_audio[seg].len <= sizeof(wav_header_t)) {
-        ESP_LOGW(TAG, "sr_echo_play(%d): buffer invalid (len=%u)", seg, (unsigned)s_audio[seg].len);
+    if (!s_earcon[seg].pcm) {
+        ESP_LOGW(TAG, "sr_echo_play(%d): not loaded", seg);
         return ESP_ERR_INVALID_STATE;
     }
-
-    uint8_t *p = s_audio[seg].buf;
-    wav_header_t *h = (wav_header_t *)p;
-    p += sizeof(wav_header_t);
-    size_t len = s_audio[seg].len - sizeof(wav_header_t);
-    len &= 0xfffffffc;
-
-    /* Configure codec for wav format */
-    ESP_LOGI(TAG, "sr_echo_play(%d): %d Hz, %d bits, data_len=%u", seg,
-             (int)h->SampleRate, (int)h->BitsPerSample, (unsigned)len);
-    bsp_codec_set_fs(h->SampleRate, h->BitsPerSample, I2S_SLOT_MODE_STEREO);
-    /* Ensure codec is unmuted and volume is reasonable for feedback tones */
-    bsp_codec_mute_set(false);
-    int vol = 100;
-    bsp_codec_volume_set(vol, &vol);
-
-    size_t bytes_written = 0;
-    s_audio_playing = true;
-    bsp_i2s_write((char *)p, len, &bytes_written, portMAX_DELAY);
-    ESP_LOGI(TAG, "sr_echo_play(%d): wrote %u bytes", seg, (unsigned)bytes_written);
-    vTaskDelay(pdMS_TO_TICKS(20));
-    s_audio_playing = false;
-    return ESP_OK;
+    /* Already in the mixer's format, returns right away */
+    return audio_mixer_play_earcon(s_earcon[seg].pcm, s_earcon[seg].frames);
 }
 
 bool sr_echo_is_playing(void)
 {
-    return s_audio_playing;
+    return audio_mixer_earcon_is_playing();
 }
 
 void sr_handler_task(void *pvParam)
@@ -154,6 +129,7 @@ void sr_handler_task(void *pvParam)
     if (sr_echo_init() != ESP_OK) {
         ESP_LOGW(TAG, "SR echo wav init failed (tones disabled)");
     }
+    ESP_ERROR_CHECK(app_sr_action_init());
 
     while (true) {
         sr_result_t result;
@@ -188,123 +164,12 @@ void sr_handler_task(void *pvParam)
             (void)sr_echo_play(AUDIO_OK);
             sr_anim_stop();
 
-            switch (cmd ? cmd->cmd : SR_CMD_MAX) {
-            // Smart home Node  commands
-            case SR_CMD_TURN_ON_LIGHT_ONE:
-                // send light_one_ctrl_on command to smart home node
-                app_espnow_send_command(TURN_ON_LIGHT_ONE);
-                break;
-            case SR_CMD_TURN_OFF_LIGHT_ONE:
-                // send light_one_ctrl_off command to smart home node
-                app_espnow_send_command(TURN_OFF_LIGHT_ONE);
-                break;
-            case SR_CMD_TURN_ON_SOCKET:
-                // send socket_ctrl_on command to smart home node
-                app_espnow_send_command(TURN_ON_SOCKET);
-                break;
-            case SR_CMD_TURN_OFF_SOCKET:
-                // send socket_ctrl_off command to smart home node
-                app_espnow_send_command(TURN_OFF_SOCKET);
-                break;
-            case SR_CMD_TURN_ON_FAN_AT_LEVEL_ONE:
-                // send fan_ctrl_on_level_one command to smart home node
-                app_espnow_send_command(TURN_ON_FAN_AT_LEVEL_ONE);
-                break;
-            case SR_CMD_TURN_ON_FAN_AT_LEVEL_TWO:
-                // send fan_ctrl_on_level_two command to smart home node
-                app_espnow_send_command(TURN_ON_FAN_AT_LEVEL_TWO);
-                break;
-            case SR_CMD_TURN_ON_FAN_AT_LEVEL_THREE:
-                // send fan_ctrl_on_level_three command to smart home node
-                app_espnow_send_command(TURN_ON_FAN_AT_LEVEL_THREE);
-                break;
-            case SR_CMD_TURN_OFF_FAN:
-                // send fan_ctrl_off command to smart home node
-                app_espnow_send_command(TURN_OFF_FAN);
-                break;
-            //Health Node command task
-            case SR_CMD_CHECK_HEALTH:
-                // read health_status command from Health node
-                // health_ui_set(true) show result and text of data that recieved for heart and spo2
-                break;
-            // DOOR NODE commands task
-            case SR_CMD_LOCK_THE_DOOR:
-                // send lock_the_door command to Door node
-                app_espnow_send_door_command("lock");
-                // Switch to Door UI
-                main_ui_show(false);
-                door_ui_show(true);
-                door_ui_set(true);
-                // Wait for 3 seconds then return to Main UI
-                vTaskDelay(pdMS_TO_TICKS(3000));
-                door_ui_show(false);
-                main_ui_show(true);
-                break;
-            case SR_CMD_UNLOCK_THE_DOOR:
-                // send unlock_the_door command to Door node
-                app_espnow_send_door_command("unlock");
-                // Switch to Door UI
-                main_ui_show(false);
-                door_ui_show(true);
-                door_ui_set(false);
-                // Wait for 3 seconds then return to Main UI
-                vTaskDelay(pdMS_TO_TICKS(3000));
-                door_ui_show(false);
-                main_ui_show(true);
-                break;
-            // robot task on command
-            case SR_CMD_WALK_FORWARD_AIGIS:
-                ESP_LOGI(TAG, "Walk Forward Aigis");
-                app_uart_send_cmd('F'); // Send UART command
-                // send walk command to robot node
-                // walking_face_ui_set(true)
-                break;
-            case SR_CMD_STOP_AIGIS:
-                ESP_LOGI(TAG, "Stop Aigis");
-                sr_anim_set_text("Stopped");
-                app_uart_send_cmd('H'); // Send UART command
-                // Stop Dance UI and Audio
-                dance_ui_show(false);
-                // Stop Story UI and Audio
-                story_ui_show(false);
-                // Stop Fall Alarm
-                app_fall_monitor_stop_alarm();
-                // Return to default UI
-                main_ui_show(true); 
-                break;
-            case SR_CMD_LETS_DANCE_AIGIS:
-                ESP_LOGI(TAG, "Let's Dance Aigis");
-                sr_anim_set_text("Dancing...");
-                app_uart_send_cmd('D'); // Send UART command
-                // Hide other UIs
-                main_ui_show(false);
-                door_ui_show(false);
-                // Show Dance UI and Play Audio
-                dance_ui_show(true);
-                break;
-            case SR_CMD_TELL_A_STORY:
-                ESP_LOGI(TAG, "Tell a Story");
-                sr_anim_set_text("Story Time");
-                // Hide other UIs
-                main_ui_show(false);
-                door_ui_show(false);
-                dance_ui_show(false);
-                // Show Story UI and Play Audio
-                story_ui_show(true);
-                break;
-            default:
+            const sr_action_t *actions = (cmd && cmd->cmd < SR_CMD_MAX) ? s_cmd_actions[cmd->cmd] : NULL;
+            if (actions) {
+                app_sr_action_run(actions);
+            } else {
                 ESP_LOGW(TAG, "Unhandled cmd");
-                break;
             }
-            
-            // For other generic commands that don't switch UI permanently, 
-            // ensure we are back on Main Face if not in a persistent mode.
-            // However, current logic in switch cases is specific. 
-            // The user requested: "show Main_Face.h image in LCD after any comand is exicuted".
-            // Since Dance and Story seem to be persistent modes (playing audio), we leave them active.
-            // Door commands have the 3s delay implemented above.
-            // Other commands (like Smart Home) are currently empty but should default to Main Face too if they had UI.
-            // Since they are empty comments, no UI change happens, so Main Face stays if it was there.
         }
     }
 }
@@ -0,0 +1,42 @@
+/*
+ * Audio Interleave: channel layout helpers for the SR feed path.
+ */
+
+#include "audio_interleave.h"
+
+/* Word view of the int16_t samples; may_alias keeps the accesses defined under strict aliasing.
+ * memcpy would be too, but only knows the buffer is 2-byte aligned, so it may split each word */
+typedef uint32_t __attribute__((may_alias)) audio_word_t;
+
+void audio_interleave_2to3(int16_t *buf, size_t frames)
+{
+    size_t i = frames;
+
+    /* Walk backwards so the expanded output never overwrites unread input.
+     * The odd trailing frame (if any) is the last one, so it goes first. */
+    if (i & 1) {
+        i--;
+        buf[i * 3 + 2] = 0;
+        buf[i * 3 + 1] = buf[i * 2 + 1];
+        buf[i * 3 + 0] = buf[i * 2 + 0];
+    }
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    /* Two frames per step with 32-bit words: {L0 R0}{L1 R1} -> {L0 R0}{0 L1}{R1 0}.
+     * Two loads and three stores replace six halfword moves. */
+    audio_word_t *w = (audio_word_t *)buf;
+    for (size_t p = i / 2; p-- > 0;) {
+        uint32_t in0 = w[p * 2 + 0];
+        uint32_t in1 = w[p * 2 + 1];
+        w[p * 3 + 2] = in1 >> 16;
+        w[p * 3 + 1] = in1 << 16;
+        w[p * 3 + 0] = in0;
+    }
+#else
+    while (i-- > 0) {
+        buf[i * 3 + 2] = 0;
+        buf[i * 3 + 1] = buf[i * 2 + 1];
+        buf[i * 3 + 0] = buf[i * 2 + 0];
+    }
+#endif
+}
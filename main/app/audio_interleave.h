@@ -0,0 +1,28 @@
+/*
+ * Audio Interleave: channel layout helpers for the SR feed path.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Expand interleaved 2-channel PCM into the 3-channel layout expected by the AFE.
+ *
+ * Each frame {mic0, mic1} becomes {mic0, mic1, 0}; the third (reference) channel is zeroed.
+ * Works in place: `buf` holds `frames * 2` samples on entry and `frames * 3` on return,
+ * so it must be sized for the 3-channel result.
+ *
+ * @param buf 4-byte aligned sample buffer
+ * @param frames Number of frames in the buffer
+ */
+void audio_interleave_2to3(int16_t *buf, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,323 @@
+/*
+ * Audio Mixer: the only writer to the speaker.
+ */
+
+#include "audio_mixer.h"
+
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "bsp_board.h"
+#include "audio_ring.h"
+
+static const char *TAG = "audio_mixer";
+
+#define MIXER_BLOCK_FRAMES      (256)   /* 16 ms, also the earcon start latency */
+#define MIXER_STREAM_SLOTS      (8)
+#define MIXER_TASK_PRIORITY     (6)
+#define MIXER_TASK_CORE         (1)
+
+/* Stream gain while an earcon plays (Q15, about -12 dB) and the per-frame ramp step */
+#define MIXER_DUCK_GAIN         (8192)
+#define MIXER_DUCK_STEP         (64)
+#define MIXER_UNITY_GAIN        (32767)
+
+typedef struct {
+    uint32_t channels;
+    uint32_t step;          /* Input frames per output frame, Q16 */
+    uint32_t phase;         /* Position in [prev, in0, in1, ...], Q16 */
+    int16_t prev[2];        /* Last input frame of the previous write */
+} stream_resampler_t;
+
+static TaskHandle_t s_mixer_task = NULL;
+static portMUX_TYPE s_mixer_lock = portMUX_INITIALIZER_UNLOCKED;
+static int16_t s_out_buf[MIXER_BLOCK_FRAMES * AUDIO_MIXER_CHANNELS];
+
+/* Earcon hand-over, protected by s_mixer_lock */
+static const int16_t *s_earcon_next = NULL;
+static size_t s_earcon_next_frames = 0;
+static volatile bool s_earcon_playing = false;
+
+/* Stream voice; the writer side is only touched by the producer task */
+static audio_ring_t *s_stream_ring = NULL;
+static int16_t *s_stream_slot = NULL;
+static size_t s_stream_fill = 0;
+static stream_resampler_t s_resampler;
+static TaskHandle_t s_writer_task = NULL;
+static volatile bool s_writer_waiting = false;
+static bool s_stream_muted = false;
+static volatile bool s_stream_flush = false;
+static volatile uint32_t s_stream_played = 0;
+
+static inline int16_t mixer_sat16(int32_t v)
+{
+    return (v > INT16_MAX) ? INT16_MAX : ((v < INT16_MIN) ? INT16_MIN : v);
+}
+
+static void mixer_task(void *pvParam)
+{
+    (void)pvParam;
+    const int16_t *earcon = NULL;
+    size_t earcon_left = 0;
+    int32_t stream_gain = MIXER_UNITY_GAIN;
+    bool out_active = false;
+
+    while (true) {
+        if (s_stream_flush) {
+            while (audio_ring_read_acquire(s_stream_ring)) {
+                audio_ring_read_release(s_stream_ring);
+            }
+            s_stream_flush = false;
+        }
+
+        portENTER_CRITICAL(&s_mixer_lock);
+        if (s_earcon_next) {
+            earcon = s_earcon_next;
+            earcon_left = s_earcon_next_frames;
+            s_earcon_next = NULL;
+        }
+        portEXIT_CRITICAL(&s_mixer_lock);
+
+        const int16_t *stream = audio_ring_read_acquire(s_stream_ring);
+        if (!stream && !earcon) {
+            if (out_active) {
+                /* Leave silence behind in the DMA buffers before going idle */
+                memset(s_out_buf, 0, sizeof(s_out_buf));
+                size_t bytes_written = 0;
+                bsp_i2s_write(s_out_buf, sizeof(s_out_buf), &bytes_written, portMAX_DELAY);
+                out_active = false;
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+        out_active = true;
+
+        int32_t target = earcon ? MIXER_DUCK_GAIN : MIXER_UNITY_GAIN;
+        size_t earcon_n = earcon ? MIN(earcon_left, MIXER_BLOCK_FRAMES) : 0;
+        int16_t *out = s_out_buf;
+        for (size_t i = 0; i < MIXER_BLOCK_FRAMES; i++) {
+            if (stream_gain < target) {
+                stream_gain = MIN(stream_gain + MIXER_DUCK_STEP, target);
+            } else if (stream_gain > target) {
+                stream_gain = MAX(stream_gain - MIXER_DUCK_STEP, target);
+            }
+            for (size_t c = 0; c < AUDIO_MIXER_CHANNELS; c++) {
+                int32_t v = 0;
+                if (stream) {
+                    v = (stream[i * AUDIO_MIXER_CHANNELS + c] * stream_gain) >> 15;
+                }
+                if (i < earcon_n) {
+                    v += earcon[i * AUDIO_MIXER_CHANNELS + c];
+                }
+                *out++ = mixer_sat16(v);
+            }
+        }
+
+        if (stream) {
+            audio_ring_read_release(s_stream_ring);
+            s_stream_played += MIXER_BLOCK_FRAMES;
+            if (s_writer_waiting) {
+                xTaskNotifyGive(s_writer_task);
+            }
+        }
+        if (earcon) {
+            earcon += earcon_n * AUDIO_MIXER_CHANNELS;
+            earcon_left -= earcon_n;
+            if (0 == earcon_left) {
+                earcon = NULL;
+                portENTER_CRITICAL(&s_mixer_lock);
+                if (!s_earcon_next) {
+                    s_earcon_playing = false;
+                }
+                portEXIT_CRITICAL(&s_mixer_lock);
+            }
+        }
+
+        size_t bytes_written = 0;
+        bsp_i2s_write(s_out_buf, sizeof(s_out_buf), &bytes_written, portMAX_DELAY);
+    }
+}
+
+esp_err_t audio_mixer_start(void)
+{
+    if (s_mixer_task) {
+        return ESP_OK;
+    }
+
+    ESP_RETURN_ON_ERROR(audio_ring_create(MIXER_STREAM_SLOTS, sizeof(s_out_buf), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, &s_stream_ring),
+                        TAG, "Failed create stream ring");
+    audio_mixer_stream_set_format(AUDIO_MIXER_SAMPLE_RATE, 16, AUDIO_MIXER_CHANNELS);
+
+    /* The codec keeps its bsp_board_init() format; only level and mute are set here, once */
+    bsp_codec_mute_set(false);
+    int vol = 100;
+    bsp_codec_volume_set(vol, &vol);
+
+    BaseType_t ret_val = xTaskCreatePinnedToCore(mixer_task, "Audio Mixer", 3 * 1024, NULL, MIXER_TASK_PRIORITY, &s_mixer_task, MIXER_TASK_CORE);
+    if (pdPASS != ret_val) {
+        audio_ring_delete(s_stream_ring);
+        s_stream_ring = NULL;
+        s_mixer_task = NULL;
+        ESP_LOGE(TAG, "Failed create mixer task");
+        return ESP_FAIL;
+    }
+    ESP_LOGI(TAG, "Mixer started: %d Hz, %d ch, %d frames/block", AUDIO_MIXER_SAMPLE_RATE, AUDIO_MIXER_CHANNELS, MIXER_BLOCK_FRAMES);
+    return ESP_OK;
+}
+
+esp_err_t audio_mixer_play_earcon(const int16_t *pcm, size_t frames)
+{
+    ESP_RETURN_ON_FALSE(pcm && frames, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+    ESP_RETURN_ON_FALSE(s_mixer_task, ESP_ERR_INVALID_STATE, TAG, "mixer not started");
+
+    portENTER_CRITICAL(&s_mixer_lock);
+    s_earcon_next = pcm;
+    s_earcon_next_frames = frames;
+    s_earcon_playing = true;
+    portEXIT_CRITICAL(&s_mixer_lock);
+    xTaskNotifyGive(s_mixer_task);
+    return ESP_OK;
+}
+
+bool audio_mixer_earcon_is_playing(void)
+{
+    return s_earcon_playing;
+}
+
+static void stream_commit_slot(void)
+{
+    audio_ring_write_commit(s_stream_ring);
+    s_stream_slot = NULL;
+    s_stream_fill = 0;
+    xTaskNotifyGive(s_mixer_task);
+}
+
+/* Pad the block being filled with silence and hand it to the mixer */
+static void stream_commit_partial(void)
+{
+    if (s_stream_slot && s_stream_fill) {
+        memset(s_stream_slot + s_stream_fill * AUDIO_MIXER_CHANNELS, 0,
+               (MIXER_BLOCK_FRAMES - s_stream_fill) * AUDIO_MIXER_CHANNELS * sizeof(int16_t));
+        stream_commit_slot();
+    }
+}
+
+esp_err_t audio_mixer_stream_set_format(uint32_t rate, uint32_t bits, uint32_t channels)
+{
+    ESP_RETURN_ON_FALSE(rate && (1 == channels || 2 == channels), ESP_ERR_INVALID_ARG, TAG, "invalid format");
+    ESP_RETURN_ON_FALSE(16 == bits, ESP_ERR_NOT_SUPPORTED, TAG, "%u bits not supported", (unsigned)bits);
+
+    stream_commit_partial();
+    s_resampler.channels = channels;
+    s_resampler.step = (uint32_t)(((uint64_t)rate << 16) / AUDIO_MIXER_SAMPLE_RATE);
+    /* Start exactly on the first input frame */
+    s_resampler.phase = 1 << 16;
+    s_resampler.prev[0] = 0;
+    s_resampler.prev[1] = 0;
+    ESP_LOGI(TAG, "Stream format: %u Hz, %u ch", (unsigned)rate, (unsigned)channels);
+    return ESP_OK;
+}
+
+/* Linear interpolation into the current slot; returns output frames produced */
+static size_t stream_resample(const int16_t *in, size_t in_frames, int16_t *out, size_t out_max)
+{
+    stream_resampler_t *rs = &s_resampler;
+    const uint32_t ch = rs->channels;
+    const bool muted = s_stream_muted;
+    size_t n = 0;
+
+    while (n < out_max) {
+        uint32_t idx = rs->phase >> 16;
+        if (idx >= in_frames) {
+            break;
+        }
+        const int16_t *b = in + idx * ch;
+        const int16_t *a = idx ? b - ch : rs->prev;
+        int32_t frac = (rs->phase & 0xFFFF) >> 1;
+        for (size_t c = 0; c < AUDIO_MIXER_CHANNELS; c++) {
+            size_t sc = (ch == 1) ? 0 : c;
+            *out++ = muted ? 0 : a[sc] + (((b[sc] - a[sc]) * frac) >> 15);
+        }
+        rs->phase += rs->step;
+        n++;
+    }
+    return n;
+}
+
+esp_err_t audio_mixer_stream_write(const void *data, size_t len, size_t *bytes_written, uint32_t timeout_ms)
+{
+    ESP_RETURN_ON_FALSE(data && bytes_written, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+    ESP_RETURN_ON_FALSE(s_mixer_task, ESP_ERR_INVALID_STATE, TAG, "mixer not started");
+
+    stream_resampler_t *rs = &s_resampler;
+    const int16_t *in = data;
+    size_t in_frames = len / (rs->channels * sizeof(int16_t));
+    *bytes_written = 0;
+    if (0 == in_frames) {
+        return ESP_OK;
+    }
+
+    s_writer_task = xTaskGetCurrentTaskHandle();
+    while ((rs->phase >> 16) < in_frames) {
+        if (!s_stream_slot) {
+            s_stream_slot = audio_ring_write_acquire(s_stream_ring);
+            if (!s_stream_slot) {
+                s_writer_waiting = true;
+                /* Re-check after publishing the flag so a release in between is not missed */
+                s_stream_slot = audio_ring_write_acquire(s_stream_ring);
+                if (!s_stream_slot && 0 == ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout_ms))) {
+                    s_writer_waiting = false;
+                    /* Frames before the next output's right-hand neighbour are consumed; rebase on
+                     * them so the caller can resubmit the rest without a skip or a repeat */
+                    const size_t used = rs->phase >> 16;
+                    if (used) {
+                        rs->phase -= used << 16;
+                        memcpy(rs->prev, in + (used - 1) * rs->channels, rs->channels * sizeof(int16_t));
+                    }
+                    *bytes_written = used * rs->channels * sizeof(int16_t);
+                    return ESP_ERR_TIMEOUT;
+                }
+                s_writer_waiting = false;
+                continue;
+            }
+        }
+
+        s_stream_fill += stream_resample(in, in_frames, s_stream_slot + s_stream_fill * AUDIO_MIXER_CHANNELS,
+                                         MIXER_BLOCK_FRAMES - s_stream_fill);
+        if (MIXER_BLOCK_FRAMES == s_stream_fill) {
+            stream_commit_slot();
+        }
+    }
+
+    rs->phase -= in_frames << 16;
+    memcpy(rs->prev, in + (in_frames - 1) * rs->channels, rs->channels * sizeof(int16_t));
+    *bytes_written = len;
+    return ESP_OK;
+}
+
+void audio_mixer_stream_mute(bool mute)
+{
+    if (mute) {
+        stream_commit_partial();
+    }
+    s_stream_muted = mute;
+}
+
+uint32_t audio_mixer_stream_played_frames(void)
+{
+    return s_stream_played;
+}
+
+void audio_mixer_stream_flush(void)
+{
+    if (!s_mixer_task) {
+        return;
+    }
+    s_stream_flush = true;
+    xTaskNotifyGive(s_mixer_task);
+}
@@ -0,0 +1,90 @@
+/*
+ * Audio Mixer: the only writer to the speaker.
+ *
+ * Output is fixed at the codec's boot configuration (16 kHz, 16-bit, stereo), so the
+ * codec is never reopened and microphone capture is never disturbed. Two voices are
+ * mixed: an earcon played straight from a caller-owned PCM buffer, and one stream
+ * (the MP3 player output) that is converted and resampled on the way in. The stream
+ * is ducked while an earcon is playing.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_MIXER_SAMPLE_RATE     (16000)
+#define AUDIO_MIXER_CHANNELS        (2)
+
+/**
+ * @brief Start the mixer task. Safe to call more than once.
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t audio_mixer_start(void);
+
+/**
+ * @brief Start an earcon, replacing the one currently playing. Never blocks.
+ *
+ * @param pcm Interleaved 16-bit stereo samples at AUDIO_MIXER_SAMPLE_RATE; must stay valid while playing
+ * @param frames Number of frames in `pcm`
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t audio_mixer_play_earcon(const int16_t *pcm, size_t frames);
+
+/**
+ * @brief Whether an earcon is queued or playing.
+ */
+bool audio_mixer_earcon_is_playing(void);
+
+/**
+ * @brief Stream: set the format of the following writes and restart the resampler.
+ *
+ * The stream functions must all be called from the same task.
+ *
+ * @param rate Sample rate in Hz
+ * @param bits Bits per sample, only 16 is supported
+ * @param channels 1 or 2
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t audio_mixer_stream_set_format(uint32_t rate, uint32_t bits, uint32_t channels);
+
+/**
+ * @brief Stream: queue interleaved PCM in the format set by audio_mixer_stream_set_format().
+ *
+ * Blocks while the stream buffer is full, which paces the producer to real time.
+ *
+ * @param bytes_written Input bytes consumed
+ * @return esp_err_t ESP_OK, or ESP_ERR_TIMEOUT if the buffer stayed full for timeout_ms
+ */
+esp_err_t audio_mixer_stream_write(const void *data, size_t len, size_t *bytes_written, uint32_t timeout_ms);
+
+/**
+ * @brief Stream: write silence in place of the data passed from now on.
+ *
+ * Audio already queued still plays out; muting also pushes out a partially filled block.
+ */
+void audio_mixer_stream_mute(bool mute);
+
+/**
+ * @brief Stream: frames at AUDIO_MIXER_SAMPLE_RATE sent to the speaker so far, including muted ones.
+ *
+ * Only advances while stream audio actually plays, so it is the clock to sync visuals to.
+ * Monotonic, wraps around; use differences. May be called from any task.
+ */
+uint32_t audio_mixer_stream_played_frames(void);
+
+/**
+ * @brief Drop the stream audio queued so far. May be called from any task.
+ */
+void audio_mixer_stream_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
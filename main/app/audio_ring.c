@@ -0,0 +1,93 @@
+/*
+ * Audio Ring: lock-free single-producer/single-consumer ring of fixed-size audio slots.
+ */
+
+#include "audio_ring.h"
+
+#include <stdatomic.h>
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+
+static const char *TAG = "audio_ring";
+
+struct audio_ring_t {
+    uint8_t *slots;
+    size_t slot_size;
+    uint32_t mask;
+    /* Free-running counters; head is written by the producer only, tail by the consumer only */
+    atomic_uint head;
+    atomic_uint tail;
+};
+
+esp_err_t audio_ring_create(size_t slot_num, size_t slot_size, uint32_t caps, audio_ring_t **ret_ring)
+{
+    ESP_RETURN_ON_FALSE(ret_ring && slot_size, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+    ESP_RETURN_ON_FALSE(slot_num && !(slot_num & (slot_num - 1)), ESP_ERR_INVALID_ARG, TAG, "slot_num must be a power of two");
+
+    audio_ring_t *ring = heap_caps_calloc(1, sizeof(audio_ring_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(ring, ESP_ERR_NO_MEM, TAG, "no mem for ring");
+
+    /* Keep slots 4-byte aligned so they can be used as word buffers */
+    slot_size = (slot_size + 3) & ~3U;
+    ring->slots = heap_caps_aligned_alloc(4, slot_num * slot_size, caps);
+    if (!ring->slots) {
+        heap_caps_free(ring);
+        ESP_LOGE(TAG, "no mem for %u x %u bytes slots", (unsigned)slot_num, (unsigned)slot_size);
+        return ESP_ERR_NO_MEM;
+    }
+    ring->slot_size = slot_size;
+    ring->mask = slot_num - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+
+    *ret_ring = ring;
+    return ESP_OK;
+}
+
+void audio_ring_delete(audio_ring_t *ring)
+{
+    if (!ring) {
+        return;
+    }
+    heap_caps_free(ring->slots);
+    heap_caps_free(ring);
+}
+
+void *audio_ring_write_acquire(audio_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    if (head - tail > ring->mask) {
+        return NULL;
+    }
+    return ring->slots + (head & ring->mask) * ring->slot_size;
+}
+
+void audio_ring_write_commit(audio_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+}
+
+void *audio_ring_read_acquire(audio_ring_t *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if (head == tail) {
+        return NULL;
+    }
+    return ring->slots + (tail & ring->mask) * ring->slot_size;
+}
+
+void audio_ring_read_release(audio_ring_t *ring)
+{
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+size_t audio_ring_count(const audio_ring_t *ring)
+{
+    uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return head - tail;
+}
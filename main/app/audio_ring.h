@@ -0,0 +1,65 @@
+/*
+ * Audio Ring: lock-free single-producer/single-consumer ring of fixed-size audio slots.
+ *
+ * The producer fills the slot returned by audio_ring_write_acquire() in place and
+ * publishes it with audio_ring_write_commit(); the consumer does the same with
+ * audio_ring_read_acquire()/audio_ring_read_release(). No locks are taken, so the
+ * two sides may run on different cores at any priority.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct audio_ring_t audio_ring_t;
+
+/**
+ * @brief Create a ring.
+ *
+ * @param slot_num Number of slots, must be a power of two
+ * @param slot_size Size of each slot in bytes
+ * @param caps Heap capabilities for the slot storage (e.g. MALLOC_CAP_SPIRAM)
+ * @param ret_ring Created ring
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t audio_ring_create(size_t slot_num, size_t slot_size, uint32_t caps, audio_ring_t **ret_ring);
+
+/**
+ * @brief Free a ring. Neither side may be using it.
+ */
+void audio_ring_delete(audio_ring_t *ring);
+
+/**
+ * @brief Producer: get the next free slot, or NULL if the ring is full.
+ */
+void *audio_ring_write_acquire(audio_ring_t *ring);
+
+/**
+ * @brief Producer: publish the slot returned by the last audio_ring_write_acquire().
+ */
+void audio_ring_write_commit(audio_ring_t *ring);
+
+/**
+ * @brief Consumer: get the oldest filled slot, or NULL if the ring is empty.
+ */
+void *audio_ring_read_acquire(audio_ring_t *ring);
+
+/**
+ * @brief Consumer: return the slot obtained by the last audio_ring_read_acquire().
+ */
+void audio_ring_read_release(audio_ring_t *ring);
+
+/**
+ * @brief Number of filled slots. Exact when called from either side.
+ */
+size_t audio_ring_count(const audio_ring_t *ring);
+
+#ifdef __cplusplus
+}
+#endif
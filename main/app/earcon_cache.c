@@ -0,0 +1,159 @@
+/*
+ * Earcon Cache: WAV clips converted once at boot to the audio mixer's output format.
+ */
+
+#include "earcon_cache.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+#include "audio_mixer.h"
+
+static const char *TAG = "earcon_cache";
+
+typedef struct {
+    char id[4];
+    uint32_t size;
+} riff_chunk_t;
+
+typedef struct {
+    uint16_t audio_format;
+    uint16_t channels;
+    uint32_t sample_rate;
+    uint32_t byte_rate;
+    uint16_t block_align;
+    uint16_t bits_per_sample;
+} wav_fmt_t;
+
+/* Walk the RIFF chunks; on success fp is positioned at the start of the sample data */
+static esp_err_t wav_parse(FILE *fp, wav_fmt_t *fmt, uint32_t *data_size)
+{
+    uint8_t riff[12];
+    ESP_RETURN_ON_FALSE(1 == fread(riff, sizeof(riff), 1, fp), ESP_ERR_INVALID_SIZE, TAG, "file too short");
+    ESP_RETURN_ON_FALSE(!memcmp(riff, "RIFF", 4) && !memcmp(riff + 8, "WAVE", 4), ESP_ERR_INVALID_RESPONSE, TAG, "not a WAV file");
+
+    bool have_fmt = false;
+    riff_chunk_t chunk;
+    while (1 == fread(&chunk, sizeof(chunk), 1, fp)) {
+        if (!memcmp(chunk.id, "fmt ", 4)) {
+            ESP_RETURN_ON_FALSE(chunk.size >= sizeof(wav_fmt_t), ESP_ERR_INVALID_SIZE, TAG, "fmt chunk too short");
+            ESP_RETURN_ON_FALSE(1 == fread(fmt, sizeof(wav_fmt_t), 1, fp), ESP_ERR_INVALID_SIZE, TAG, "read fmt failed");
+            chunk.size -= sizeof(wav_fmt_t);
+            have_fmt = true;
+        } else if (!memcmp(chunk.id, "data", 4)) {
+            ESP_RETURN_ON_FALSE(have_fmt, ESP_ERR_INVALID_RESPONSE, TAG, "data before fmt");
+            *data_size = chunk.size;
+            return ESP_OK;
+        }
+        /* Skip LIST and anything else; chunks are padded to an even size */
+        fseek(fp, chunk.size + (chunk.size & 1), SEEK_CUR);
+    }
+    ESP_LOGE(TAG, "no data chunk");
+    return ESP_ERR_NOT_FOUND;
+}
+
+static int16_t *earcon_alloc(size_t size, const char **where)
+{
+    int16_t *buf = heap_caps_malloc(size, MALLOC_CAP_DMA | MALLOC_CAP_INTERNAL);
+    *where = "internal";
+    if (!buf) {
+        buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        *where = "psram";
+    }
+    return buf;
+}
+
+static inline int32_t wav_sample(const uint8_t *raw, const wav_fmt_t *fmt, size_t frame, size_t ch)
+{
+    size_t i = frame * fmt->channels + ((1 == fmt->channels) ? 0 : ch);
+    if (8 == fmt->bits_per_sample) {
+        return ((int32_t)raw[i] - 128) << 8;
+    }
+    return ((const int16_t *)raw)[i];
+}
+
+esp_err_t earcon_cache_load(const char *path, earcon_t *earcon)
+{
+    esp_err_t ret = ESP_OK;
+    uint8_t *raw = NULL;
+    int16_t *pcm = NULL;
+    const char *where = NULL;
+    ESP_RETURN_ON_FALSE(path && earcon, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+    earcon_cache_free(earcon);
+
+    FILE *fp = fopen(path, "rb");
+    ESP_RETURN_ON_FALSE(fp, ESP_ERR_NOT_FOUND, TAG, "Failed open %s", path);
+
+    wav_fmt_t fmt;
+    uint32_t data_size = 0;
+    ESP_GOTO_ON_ERROR(wav_parse(fp, &fmt, &data_size), err, TAG, "%s: bad WAV", path);
+    ESP_GOTO_ON_FALSE(1 == fmt.audio_format && (1 == fmt.channels || 2 == fmt.channels)
+                      && (8 == fmt.bits_per_sample || 16 == fmt.bits_per_sample)
+                      && fmt.sample_rate >= 8000 && fmt.sample_rate <= 48000,
+                      ESP_ERR_NOT_SUPPORTED, err, TAG, "%s: unsupported format %u/%u ch/%u bit/%lu Hz", path,
+                      fmt.audio_format, fmt.channels, fmt.bits_per_sample, (unsigned long)fmt.sample_rate);
+
+    const size_t in_block = fmt.channels * fmt.bits_per_sample / 8;
+    const size_t in_frames = data_size / in_block;
+    ESP_GOTO_ON_FALSE(in_frames > 1, ESP_ERR_INVALID_SIZE, err, TAG, "%s: no samples", path);
+
+    const size_t out_block = AUDIO_MIXER_CHANNELS * sizeof(int16_t);
+    const size_t out_frames = (uint64_t)in_frames * AUDIO_MIXER_SAMPLE_RATE / fmt.sample_rate;
+    pcm = earcon_alloc(out_frames * out_block, &where);
+    ESP_GOTO_ON_FALSE(pcm, ESP_ERR_NO_MEM, err, TAG, "%s: no mem for %u frames", path, (unsigned)out_frames);
+
+    if (AUDIO_MIXER_SAMPLE_RATE == fmt.sample_rate && AUDIO_MIXER_CHANNELS == fmt.channels && 16 == fmt.bits_per_sample) {
+        /* Already native, read straight into place */
+        ESP_GOTO_ON_FALSE(out_frames == fread(pcm, out_block, out_frames, fp), ESP_ERR_INVALID_SIZE, err, TAG, "%s: read failed", path);
+    } else {
+        raw = heap_caps_malloc(in_frames * in_block, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        ESP_GOTO_ON_FALSE(raw, ESP_ERR_NO_MEM, err, TAG, "%s: no mem for conversion", path);
+        ESP_GOTO_ON_FALSE(in_frames == fread(raw, in_block, in_frames, fp), ESP_ERR_INVALID_SIZE, err, TAG, "%s: read failed", path);
+
+        /* Linear interpolation, step in Q16 input frames */
+        const uint32_t step = (uint32_t)(((uint64_t)fmt.sample_rate << 16) / AUDIO_MIXER_SAMPLE_RATE);
+        uint64_t pos = 0;
+        int16_t *out = pcm;
+        for (size_t k = 0; k < out_frames; k++, pos += step) {
+            size_t idx = pos >> 16;
+            size_t next = (idx + 1 < in_frames) ? idx + 1 : idx;
+            int32_t frac = (pos & 0xFFFF) >> 1;
+            for (size_t c = 0; c < AUDIO_MIXER_CHANNELS; c++) {
+                int32_t a = wav_sample(raw, &fmt, idx, c);
+                int32_t b = wav_sample(raw, &fmt, next, c);
+                *out++ = a + (((b - a) * frac) >> 15);
+            }
+        }
+        heap_caps_free(raw);
+        raw = NULL;
+    }
+    fclose(fp);
+
+    earcon->pcm = pcm;
+    earcon->frames = out_frames;
+    ESP_LOGI(TAG, "%s: %lu Hz/%u ch/%u bit -> %u frames in %s", path, (unsigned long)fmt.sample_rate,
+             fmt.channels, fmt.bits_per_sample, (unsigned)out_frames, where);
+    return ESP_OK;
+
+err:
+    if (raw) {
+        heap_caps_free(raw);
+    }
+    if (pcm) {
+        heap_caps_free(pcm);
+    }
+    fclose(fp);
+    return ret;
+}
+
+void earcon_cache_free(earcon_t *earcon)
+{
+    if (earcon && earcon->pcm) {
+        heap_caps_free(earcon->pcm);
+        earcon->pcm = NULL;
+        earcon->frames = 0;
+    }
+}
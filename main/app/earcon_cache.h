@@ -0,0 +1,43 @@
+/*
+ * Earcon Cache: WAV clips converted once at boot to the audio mixer's output format.
+ *
+ * Any PCM WAV (8/16-bit, mono/stereo, any rate, extra chunks such as LIST) is parsed,
+ * converted to 16-bit stereo and resampled to AUDIO_MIXER_SAMPLE_RATE, so playback
+ * is just handing the buffer to audio_mixer_play_earcon().
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    int16_t *pcm;       /*!< Interleaved stereo at AUDIO_MIXER_SAMPLE_RATE */
+    size_t frames;
+} earcon_t;
+
+/**
+ * @brief Load and convert a WAV file.
+ *
+ * The samples go to internal DMA-capable memory when it fits, otherwise to PSRAM,
+ * so load the latency-critical clips first.
+ *
+ * @param path WAV file path
+ * @param earcon Loaded clip; freed first if it already holds one
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t earcon_cache_load(const char *path, earcon_t *earcon);
+
+/**
+ * @brief Free a loaded clip.
+ */
+void earcon_cache_free(earcon_t *earcon);
+
+#ifdef __cplusplus
+}
+#endif
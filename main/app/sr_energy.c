@@ -0,0 +1,76 @@
+/*
+ * SR Energy: per-chunk band energy of the AFE output, for the speech overlay.
+ */
+
+#include "sr_energy.h"
+
+#include <stdatomic.h>
+
+/*
+ * Bands are split with three one-pole low-pass filters, a = 1 - exp(-2 pi fc / 16000) in Q15,
+ * and taken as differences: band 0 = lp0, 1 = lp1 - lp0, 2 = lp2 - lp1, 3 = x - lp2.
+ */
+static const int32_t s_lp_coef[SR_ENERGY_BANDS - 1] = {
+    4768,   /* 400 Hz */
+    10640,  /* 1 kHz */
+    20493,  /* 2.5 kHz */
+};
+
+/* Mean square mapped to levels: log2 in Q3, 48 dB up from about -60 dBFS */
+#define SR_ENERGY_LOG2_FLOOR_Q3 (10 << 3)
+#define SR_ENERGY_LOG2_SPAN_Q3  (16 << 3)
+
+static int32_t s_lp[SR_ENERGY_BANDS - 1];
+static atomic_uint s_levels;
+
+/* log2(v) in Q3: integer part from the leading one, fraction from the next three bits */
+static inline int32_t sr_energy_log2_q3(uint32_t v)
+{
+    if (0 == v) {
+        return 0;
+    }
+    int32_t msb = 31 - __builtin_clz(v);
+    uint32_t frac = (msb >= 3) ? (v >> (msb - 3)) & 0x7 : (v << (3 - msb)) & 0x7;
+    return (msb << 3) | frac;
+}
+
+void sr_energy_update(const int16_t *pcm, size_t samples)
+{
+    if (!pcm || !samples) {
+        return;
+    }
+
+    uint64_t sum[SR_ENERGY_BANDS] = {0};
+    int32_t lp0 = s_lp[0], lp1 = s_lp[1], lp2 = s_lp[2];
+    for (size_t i = 0; i < samples; i++) {
+        const int32_t x = pcm[i];
+        lp0 += ((x - lp0) * s_lp_coef[0]) >> 15;
+        lp1 += ((x - lp1) * s_lp_coef[1]) >> 15;
+        lp2 += ((x - lp2) * s_lp_coef[2]) >> 15;
+        const int32_t b1 = lp1 - lp0, b2 = lp2 - lp1, b3 = x - lp2;
+        /* Differences reach 17 bits; their squares still fit unsigned 32-bit */
+        sum[0] += (uint32_t)lp0 * (uint32_t)lp0;
+        sum[1] += (uint32_t)b1 * (uint32_t)b1;
+        sum[2] += (uint32_t)b2 * (uint32_t)b2;
+        sum[3] += (uint32_t)b3 * (uint32_t)b3;
+    }
+    s_lp[0] = lp0;
+    s_lp[1] = lp1;
+    s_lp[2] = lp2;
+
+    uint32_t packed = 0;
+    for (int b = 0; b < SR_ENERGY_BANDS; b++) {
+        int32_t lvl = sr_energy_log2_q3(sum[b] / samples) - SR_ENERGY_LOG2_FLOOR_Q3;
+        lvl = (lvl <= 0) ? 0 : lvl * SR_ENERGY_LEVEL_MAX / SR_ENERGY_LOG2_SPAN_Q3;
+        packed |= (uint32_t)((lvl > SR_ENERGY_LEVEL_MAX) ? SR_ENERGY_LEVEL_MAX : lvl) << (8 * b);
+    }
+    atomic_store_explicit(&s_levels, packed, memory_order_relaxed);
+}
+
+void sr_energy_get(uint8_t level[SR_ENERGY_BANDS])
+{
+    uint32_t packed = atomic_load_explicit(&s_levels, memory_order_relaxed);
+    for (int b = 0; b < SR_ENERGY_BANDS; b++) {
+        level[b] = packed >> (8 * b);
+    }
+}
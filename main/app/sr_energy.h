@@ -0,0 +1,33 @@
+/*
+ * SR Energy: per-chunk band energy of the AFE output, for the speech overlay.
+ *
+ * The detect task calls sr_energy_update() on each fetched chunk; the UI reads the latest
+ * levels with sr_energy_get(). The snapshot is one 32-bit word written with a single
+ * store, so neither side ever blocks or copies audio.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SR_ENERGY_BANDS     (4)     /*!< < 400 Hz, 400 Hz - 1 kHz, 1 - 2.5 kHz, > 2.5 kHz */
+#define SR_ENERGY_LEVEL_MAX (100)
+
+/**
+ * @brief Analyse one chunk of 16 kHz mono PCM and publish its band levels. Detect task only.
+ */
+void sr_energy_update(const int16_t *pcm, size_t samples);
+
+/**
+ * @brief Latest band levels, 0 to SR_ENERGY_LEVEL_MAX on a log scale. Any task.
+ */
+void sr_energy_get(uint8_t level[SR_ENERGY_BANDS]);
+
+#ifdef __cplusplus
+}
+#endif
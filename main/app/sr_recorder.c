@@ -0,0 +1,215 @@
+/*
+ * SR Recorder: background PCM-to-WAV writer for the speech recognition debug recording.
+ */
+
+#include "sr_recorder.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/param.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+static const char *TAG = "sr_recorder";
+
+#define SR_RECORDER_POOL_NUM        (8)
+#define SR_RECORDER_WRITE_SIZE      (32 * 1024)
+#define SR_RECORDER_BUF_CAPS        (MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT)
+#define SR_RECORDER_TASK_PRIORITY   (2)
+#define SR_RECORDER_HEADER_SIZE     (512)   /* One sector, so the buffered writes stay sector aligned */
+
+typedef struct {
+    uint8_t ChunkID[4];
+    uint32_t ChunkSize;
+    uint8_t Format[4];
+    uint8_t Subchunk1ID[4];
+    uint32_t Subchunk1Size;
+    uint16_t AudioFormat;
+    uint16_t NumChannels;
+    uint32_t SampleRate;
+    uint32_t ByteRate;
+    uint16_t BlockAlign;
+    uint16_t BitsPerSample;
+    uint8_t JunkID[4];      /* Padding chunk that players skip; puts the samples at SR_RECORDER_HEADER_SIZE */
+    uint32_t JunkSize;
+    uint8_t Junk[SR_RECORDER_HEADER_SIZE - 52];
+    uint8_t Subchunk2ID[4];
+    uint32_t Subchunk2Size;
+} wav_header_t;
+
+_Static_assert(sizeof(wav_header_t) == SR_RECORDER_HEADER_SIZE, "WAV header must fill one sector");
+
+typedef struct {
+    uint8_t *buf;   /*!< Pool buffer, NULL asks the writer to finish */
+    size_t len;
+} rec_chunk_t;
+
+struct sr_recorder_t {
+    FILE *fp;
+    char path[40];
+    wav_header_t header;
+    size_t chunk_size;
+    uint8_t *pool[SR_RECORDER_POOL_NUM];
+    QueueHandle_t free_que;
+    QueueHandle_t data_que;
+    uint8_t *write_buf;
+    size_t write_len;
+    uint32_t data_bytes;
+    uint32_t dropped;
+};
+
+static void recorder_free(sr_recorder_t *rec)
+{
+    if (rec->fp) {
+        fclose(rec->fp);
+    }
+    for (size_t i = 0; i < SR_RECORDER_POOL_NUM; i++) {
+        if (rec->pool[i]) {
+            heap_caps_free(rec->pool[i]);
+        }
+    }
+    if (rec->write_buf) {
+        heap_caps_free(rec->write_buf);
+    }
+    if (rec->free_que) {
+        vQueueDelete(rec->free_que);
+    }
+    if (rec->data_que) {
+        vQueueDelete(rec->data_que);
+    }
+    heap_caps_free(rec);
+}
+
+static void recorder_flush(sr_recorder_t *rec)
+{
+    if (rec->write_len) {
+        size_t written = fwrite(rec->write_buf, 1, rec->write_len, rec->fp);
+        if (written != rec->write_len) {
+            ESP_LOGE(TAG, "%s: short write %u/%u", rec->path, (unsigned)written, (unsigned)rec->write_len);
+        }
+        rec->data_bytes += written;
+        rec->write_len = 0;
+    }
+}
+
+static void recorder_task(void *arg)
+{
+    sr_recorder_t *rec = arg;
+    rec_chunk_t chunk;
+
+    while (true) {
+        xQueueReceive(rec->data_que, &chunk, portMAX_DELAY);
+        if (NULL == chunk.buf) {
+            break;
+        }
+
+        /* Coalesce chunks so the card only sees large sequential writes */
+        size_t off = 0;
+        while (off < chunk.len) {
+            size_t n = MIN(chunk.len - off, SR_RECORDER_WRITE_SIZE - rec->write_len);
+            memcpy(rec->write_buf + rec->write_len, chunk.buf + off, n);
+            rec->write_len += n;
+            off += n;
+            if (rec->write_len == SR_RECORDER_WRITE_SIZE) {
+                recorder_flush(rec);
+            }
+        }
+        xQueueSend(rec->free_que, &chunk.buf, 0);
+    }
+
+    recorder_flush(rec);
+    rec->header.ChunkSize = sizeof(wav_header_t) - 8 + rec->data_bytes;
+    rec->header.Subchunk2Size = rec->data_bytes;
+    fseek(rec->fp, 0, SEEK_SET);
+    fwrite(&rec->header, 1, sizeof(wav_header_t), rec->fp);
+    ESP_LOGI(TAG, "File saved: %s, %lu bytes, %lu chunks dropped",
+             rec->path, (unsigned long)rec->data_bytes, (unsigned long)rec->dropped);
+
+    recorder_free(rec);
+    vTaskDelete(NULL);
+}
+
+esp_err_t sr_recorder_open(const char *path, uint32_t sample_rate, uint16_t channels, size_t chunk_size, sr_recorder_t **ret_rec)
+{
+    esp_err_t ret = ESP_OK;
+    ESP_RETURN_ON_FALSE(path && channels && chunk_size && ret_rec, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+
+    sr_recorder_t *rec = heap_caps_calloc(1, sizeof(sr_recorder_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(rec, ESP_ERR_NO_MEM, TAG, "no mem for recorder");
+    strlcpy(rec->path, path, sizeof(rec->path));
+    rec->chunk_size = chunk_size;
+
+    rec->free_que = xQueueCreate(SR_RECORDER_POOL_NUM, sizeof(uint8_t *));
+    rec->data_que = xQueueCreate(SR_RECORDER_POOL_NUM + 1, sizeof(rec_chunk_t));
+    ESP_GOTO_ON_FALSE(rec->free_que && rec->data_que, ESP_ERR_NO_MEM, err, TAG, "no mem for queues");
+
+    for (size_t i = 0; i < SR_RECORDER_POOL_NUM; i++) {
+        rec->pool[i] = heap_caps_malloc(chunk_size, SR_RECORDER_BUF_CAPS);
+        ESP_GOTO_ON_FALSE(rec->pool[i], ESP_ERR_NO_MEM, err, TAG, "no mem for pool buffer");
+        xQueueSend(rec->free_que, &rec->pool[i], 0);
+    }
+    rec->write_buf = heap_caps_aligned_alloc(64, SR_RECORDER_WRITE_SIZE, SR_RECORDER_BUF_CAPS);
+    ESP_GOTO_ON_FALSE(rec->write_buf, ESP_ERR_NO_MEM, err, TAG, "no mem for write buffer");
+
+    rec->fp = fopen(path, "wb");
+    ESP_GOTO_ON_FALSE(rec->fp, ESP_FAIL, err, TAG, "Failed create record file %s", path);
+    /* Writes are already batched, skip the stdio copy */
+    setvbuf(rec->fp, NULL, _IONBF, 0);
+
+    wav_header_t *h = &rec->header;
+    memcpy(h->ChunkID, "RIFF", 4);
+    memcpy(h->Format, "WAVE", 4);
+    memcpy(h->Subchunk1ID, "fmt ", 4);
+    h->Subchunk1Size = 16;
+    h->AudioFormat = 1;
+    h->NumChannels = channels;
+    h->SampleRate = sample_rate;
+    h->BitsPerSample = 16;
+    h->BlockAlign = channels * sizeof(int16_t);
+    h->ByteRate = sample_rate * h->BlockAlign;
+    memcpy(h->JunkID, "JUNK", 4);
+    h->JunkSize = sizeof(h->Junk);
+    memcpy(h->Subchunk2ID, "data", 4);
+    /* Placeholder sizes, patched on close */
+    ESP_GOTO_ON_FALSE(fwrite(h, 1, sizeof(wav_header_t), rec->fp) == sizeof(wav_header_t), ESP_FAIL, err, TAG, "write header failed");
+
+    BaseType_t ret_val = xTaskCreatePinnedToCore(recorder_task, "SR Recorder", 3 * 1024, rec, SR_RECORDER_TASK_PRIORITY, NULL, tskNO_AFFINITY);
+    ESP_GOTO_ON_FALSE(pdPASS == ret_val, ESP_FAIL, err, TAG, "Failed create recorder task");
+
+    ESP_LOGI(TAG, "File created at %s", path);
+    *ret_rec = rec;
+    return ESP_OK;
+err:
+    recorder_free(rec);
+    return ret;
+}
+
+esp_err_t sr_recorder_write(sr_recorder_t *rec, const void *data, size_t len)
+{
+    ESP_RETURN_ON_FALSE(len <= rec->chunk_size, ESP_ERR_INVALID_ARG, TAG, "chunk too large");
+
+    rec_chunk_t chunk = {
+        .len = len,
+    };
+    if (pdTRUE != xQueueReceive(rec->free_que, &chunk.buf, 0)) {
+        rec->dropped++;
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(chunk.buf, data, len);
+    xQueueSend(rec->data_que, &chunk, 0);
+    return ESP_OK;
+}
+
+void sr_recorder_close(sr_recorder_t *rec)
+{
+    rec_chunk_t chunk = {
+        .buf = NULL,
+        .len = 0,
+    };
+    /* data_que has one spare slot beyond the pool, so this never fails */
+    xQueueSend(rec->data_que, &chunk, 0);
+}
@@ -0,0 +1,54 @@
+/*
+ * SR Recorder: background PCM-to-WAV writer for the speech recognition debug recording.
+ *
+ * Producers hand chunks over through a pool of preallocated buffers and never block;
+ * a low-priority task coalesces them into large writes and finalizes the WAV header
+ * on close. When the pool is exhausted the chunk is dropped; the total is logged on close.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct sr_recorder_t sr_recorder_t;
+
+/**
+ * @brief Create the WAV file and start the writer task.
+ *
+ * @param path File path, e.g. "/sdcard/Record_00_mic.wav"
+ * @param sample_rate Sample rate in Hz
+ * @param channels Number of interleaved 16-bit channels
+ * @param chunk_size Largest chunk in bytes that will be passed to sr_recorder_write()
+ * @param ret_rec Created recorder
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t sr_recorder_open(const char *path, uint32_t sample_rate, uint16_t channels, size_t chunk_size, sr_recorder_t **ret_rec);
+
+/**
+ * @brief Queue a chunk for writing. Never blocks.
+ *
+ * Must always be called from the same task.
+ *
+ * @return
+ *    - ESP_OK: Chunk queued
+ *    - ESP_ERR_NO_MEM: No free pool buffer, chunk dropped
+ *    - ESP_ERR_INVALID_ARG: Chunk larger than chunk_size
+ */
+esp_err_t sr_recorder_write(sr_recorder_t *rec, const void *data, size_t len);
+
+/**
+ * @brief Flush pending data, finalize the WAV header and close the file. Never blocks.
+ *
+ * The writer task releases all resources once it is done; `rec` must not be used afterwards.
+ */
+void sr_recorder_close(sr_recorder_t *rec);
+
+#ifdef __cplusplus
+}
+#endif
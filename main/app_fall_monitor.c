@@ -22,9 +22,17 @@ static const char *ALARM_AUDIO_PATH = "/spiffs/mp3/siren.mp3";
 // Simple state
 static bool s_alarm_active = false;
 
+// Vitals history: a ring of telemetry samples, written by the ESP-NOW receive task
+static aigis_vitals_t s_history[APP_FALL_MONITOR_HISTORY];
+static uint32_t s_history_count = 0;    // Samples ever stored; the newest is at (count - 1) % size
+static uint16_t s_period_ms = 0;
+static uint16_t s_next_sample = 0;      // Number the node gives the next sample
+static uint32_t s_samples_lost = 0;
+static portMUX_TYPE s_history_lock = portMUX_INITIALIZER_UNLOCKED;
+
 // Process received data (Called from app_espnow.c)
-void app_fall_monitor_process_data(health_node_data_t *data) {
-    if (data->fallDetected) {
+void app_fall_monitor_process_data(const aigis_health_t *data) {
+    if (data->fall) {
         ESP_LOGE(TAG, "!!! FALL DETECTED RECEIVED !!!");
         
         if (!s_alarm_active) {
@@ -56,10 +64,48 @@ void app_fall_monitor_process_data(health_node_data_t *data) {
     }
     
     // Process Heart Rate / SPO2 if needed for UI update
-    if (data->heartRate > 0 || data->spo2 > 0) {
+    if (data->heart_rate > 0 || data->spo2 > 0) {
         // TODO: Update Health UI if active
-        // ESP_LOGI(TAG, "Health Data: HR=%.1f Spo2=%d", data->heartRate, data->spo2);
+        // ESP_LOGI(TAG, "Health Data: HR=%d Spo2=%d", data->heart_rate, data->spo2);
+    }
+}
+
+void app_fall_monitor_process_telemetry(const aigis_telemetry_t *batch) {
+    if (!batch->count) {
+        return;
+    }
+    // A gap means lost frames; a jump back is a restarted node or a late frame
+    const uint16_t gap = batch->first - s_next_sample;
+    if (s_history_count && gap && gap < 0x8000) {
+        s_samples_lost += gap;
+        ESP_LOGW(TAG, "%u telemetry samples lost (%lu in total)", gap, (unsigned long)s_samples_lost);
+    }
+    s_next_sample = batch->first + batch->count;
+
+    taskENTER_CRITICAL(&s_history_lock);
+    for (int i = 0; i < batch->count; i++) {
+        s_history[s_history_count++ % APP_FALL_MONITOR_HISTORY] = batch->sample[i];
+    }
+    s_period_ms = batch->period_ms;
+    taskEXIT_CRITICAL(&s_history_lock);
+
+    const aigis_vitals_t *last = &batch->sample[batch->count - 1];
+    ESP_LOGD(TAG, "Telemetry: %d samples, last accel=%u mg HR=%d SpO2=%d", batch->count,
+             last->accel_mg, last->heart_rate, last->spo2);
+}
+
+size_t app_fall_monitor_get_vitals(aigis_vitals_t *out, size_t max, uint16_t *period_ms) {
+    taskENTER_CRITICAL(&s_history_lock);
+    const uint32_t stored = (s_history_count < APP_FALL_MONITOR_HISTORY) ? s_history_count : APP_FALL_MONITOR_HISTORY;
+    const size_t n = (max < stored) ? max : stored;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = s_history[(s_history_count - n + i) % APP_FALL_MONITOR_HISTORY];
+    }
+    if (period_ms) {
+        *period_ms = s_period_ms;
     }
+    taskEXIT_CRITICAL(&s_history_lock);
+    return n;
 }
 
 esp_err_t app_fall_monitor_init(void)
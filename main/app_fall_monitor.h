@@ -1,7 +1,12 @@
 #pragma once
 
+#include <stddef.h>
+#include <stdint.h>
 #include "esp_err.h"
-#include "app/app_espnow.h" // For health_node_data_t
+#include "aigis_proto.h"
+
+// Telemetry samples kept by the hub, a power of two
+#define APP_FALL_MONITOR_HISTORY (512)
 
 /**
  * @brief Initialize Fall Monitor (UI/Audio resources only).
@@ -14,9 +19,26 @@ esp_err_t app_fall_monitor_init(void);
 /**
  * @brief Process received data from Health Node.
  * 
- * @param data Pointer to the received health data structure.
+ * @param data Decoded health report.
+ */
+void app_fall_monitor_process_data(const aigis_health_t *data);
+
+/**
+ * @brief Append a telemetry batch from the Health Node to the vitals history.
+ * 
+ * @param batch Decoded telemetry frame
+ */
+void app_fall_monitor_process_telemetry(const aigis_telemetry_t *batch);
+
+/**
+ * @brief Copy the most recent telemetry samples, oldest first.
+ * 
+ * @param out Destination
+ * @param max Samples wanted
+ * @param period_ms Sample period reported by the node, may be NULL
+ * @return size_t Samples copied
  */
-void app_fall_monitor_process_data(health_node_data_t *data);
+size_t app_fall_monitor_get_vitals(aigis_vitals_t *out, size_t max, uint16_t *period_ms);
 
 /**
  * @brief Stop the active fall alarm (audio + UI).
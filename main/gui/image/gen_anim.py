@@ -0,0 +1,66 @@
+#!/usr/bin/env python3
+"""
+Pack a sequence of 24-bpp BMP frames into an animation file for gui/ui_anim.c.
+
+Every frame is compressed with the same RLE as `gen_lv_img.py --rle`, so the
+player streams one compressed frame at a time from SPIFFS and LVGL decodes it
+row by row. Layout, little-endian:
+
+    uint32 magic "ANM1", uint16 width, uint16 height, uint16 frames, uint16 fps,
+    uint32 largest frame size, uint32 offset[frames + 1] from the file start,
+    then the frames back to back.
+
+Put the result under spiffs/anim/, e.g.
+
+    gen_anim.py --fps 12 --swap -o ../../../spiffs/anim/dance.anim dance_*.bmp
+"""
+
+import argparse
+import struct
+import sys
+
+from gen_lv_img import bgr_rows, rle_encode, to_rgb565
+
+ANIM_MAGIC = 0x314D4E41  # "ANM1"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('frames', nargs='+', help='BMP frames, in order')
+    parser.add_argument('-o', '--output', required=True, help='generated .anim file')
+    parser.add_argument('--fps', type=int, default=12, help='playback rate')
+    parser.add_argument('--band', type=int, default=10, help='RLE band height, CONFIG_BSP_LCD_DRAW_BUF_HEIGHT')
+    parser.add_argument('--swap', action='store_true', help='LV_COLOR_16_SWAP byte order')
+    args = parser.parse_args()
+
+    blobs = []
+    size = None
+    for path in args.frames:
+        with open(path, 'rb') as f:
+            data = f.read()
+        if data[:2] != b'BM':
+            sys.exit('%s: not a BMP file' % path)
+        width, height, rows = bgr_rows(data, 0, 0)
+        if size and size != (width, height):
+            sys.exit('%s: %dx%d, expected %dx%d' % (path, width, height, size[0], size[1]))
+        size = (width, height)
+        blobs.append(rle_encode(to_rgb565(rows, args.swap), width, height, args.band))
+
+    header_size = 16 + 4 * (len(blobs) + 1)
+    offsets = [header_size]
+    for blob in blobs:
+        offsets.append(offsets[-1] + len(blob))
+
+    with open(args.output, 'wb') as f:
+        f.write(struct.pack('<IHHHHI', ANIM_MAGIC, size[0], size[1], len(blobs), args.fps, max(map(len, blobs))))
+        f.write(struct.pack('<%dI' % len(offsets), *offsets))
+        for blob in blobs:
+            f.write(blob)
+
+    raw = size[0] * size[1] * 2 * len(blobs)
+    print('%s: %d frames %dx%d, %d bytes (%.1fx)' % (args.output, len(blobs), size[0], size[1],
+                                                  offsets[-1], raw / offsets[-1]))
+
+
+if __name__ == '__main__':
+    main()
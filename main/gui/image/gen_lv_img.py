@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""
+Convert an image header (a C byte array holding a 24-bpp BMP or headerless
+top-down BGR pixels) into an LVGL true-color lv_img_dsc_t source file.
+
+The pixels are stored as RGB565 in the panel's byte order, so LVGL draws
+them straight from memory-mapped flash without a runtime copy.
+
+With --rle the pixels are compressed in the format read by gui/ui_img_rle.c:
+a header, one offset per band of rows, then per row a sequence of ops
+
+    0x00-0x3F  n+1 literal pixels follow
+    0x40-0x7F  one pixel follows, repeated n+1 times
+    0x80-0xFF  copy n+1 pixels from the row above (never on a band's first row)
+
+Bands decode independently, so a band maps onto one LVGL draw buffer.
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+
+def read_c_array(path):
+    with open(path, 'r') as f:
+        text = f.read()
+    m = re.search(r'\b(?:uint8_t|unsigned\s+char)\s+(\w+)\s*\[\s*\]\s*(?:PROGMEM\s*)?=\s*\{', text)
+    if not m:
+        sys.exit('%s: no byte array found' % path)
+    end = text.index('}', m.end())
+    values = re.findall(r'0x([0-9a-fA-F]{1,2})', text[m.end():end])
+    return bytes(int(v, 16) for v in values)
+
+
+def bgr_rows(data, width, height):
+    """Yield top-down rows of BGR888 bytes."""
+    if data[:2] == b'BM':
+        offset, = struct.unpack_from('<I', data, 10)
+        width, height = struct.unpack_from('<ii', data, 18)
+        bpp, compression = struct.unpack_from('<HI', data, 28)
+        if width <= 0 or height <= 0 or bpp != 24 or compression != 0:
+            sys.exit('unsupported BMP: %dx%d bpp=%d compression=%d' % (width, height, bpp, compression))
+        stride = (width * 3 + 3) & ~3
+        rows = [data[offset + stride * y:offset + stride * y + width * 3] for y in range(height)]
+        rows.reverse()
+    else:
+        stride = width * 3
+        if len(data) < stride * height:
+            sys.exit('raw data too short: %d < %d' % (len(data), stride * height))
+        rows = [data[stride * y:stride * (y + 1)] for y in range(height)]
+    return width, height, rows
+
+
+def to_rgb565(rows, swap):
+    out = bytearray()
+    for row in rows:
+        for x in range(0, len(row), 3):
+            b, g, r = row[x], row[x + 1], row[x + 2]
+            c = ((r & 0xF8) << 8) | ((g & 0xFC) << 3) | (b >> 3)
+            out += struct.pack('>H' if swap else '<H', c)
+    return out
+
+
+RLE_MAGIC = 0x31454C52  # "RLE1"
+RLE_LITERAL_MAX = 64
+RLE_RUN_MAX = 64
+RLE_COPY_MAX = 128
+
+
+def rle_encode_row(row, above):
+    out = bytearray()
+    literals = []
+
+    def flush_literals():
+        while literals:
+            chunk = literals[:RLE_LITERAL_MAX]
+            del literals[:RLE_LITERAL_MAX]
+            out.append(len(chunk) - 1)
+            for px in chunk:
+                out.extend(px)
+
+    x = 0
+    width = len(row)
+    while x < width:
+        copy = 0
+        if above is not None:
+            while x + copy < width and copy < RLE_COPY_MAX and row[x + copy] == above[x + copy]:
+                copy += 1
+        run = 1
+        while x + run < width and run < RLE_RUN_MAX and row[x + run] == row[x]:
+            run += 1
+        if copy and copy >= run:
+            flush_literals()
+            out.append(0x80 | (copy - 1))
+            x += copy
+        elif run >= 2:
+            flush_literals()
+            out.append(0x40 | (run - 1))
+            out += row[x]
+            x += run
+        else:
+            literals.append(row[x])
+            x += 1
+    flush_literals()
+    return out
+
+
+def rle_encode(pixels, width, height, band):
+    rows = [[bytes(pixels[(y * width + x) * 2:(y * width + x) * 2 + 2]) for x in range(width)]
+            for y in range(height)]
+    bands = (height + band - 1) // band
+    payload = bytearray()
+    offsets = []
+    for y in range(height):
+        if y % band == 0:
+            offsets.append(len(payload))
+        payload += rle_encode_row(rows[y], rows[y - 1] if y % band else None)
+    header = struct.pack('<IHHHH', RLE_MAGIC, width, height, band, 0)
+    header += struct.pack('<%dI' % bands, *offsets)
+    return header + payload
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('input', help='C header with the image byte array')
+    parser.add_argument('-o', '--output', required=True, help='generated .c file')
+    parser.add_argument('-n', '--name', required=True, help='lv_img_dsc_t symbol name')
+    parser.add_argument('--width', type=int, default=320, help='width of headerless data')
+    parser.add_argument('--height', type=int, default=240, help='height of headerless data')
+    parser.add_argument('--swap', action='store_true', help='LV_COLOR_16_SWAP byte order')
+    parser.add_argument('--rle', type=int, metavar='BAND', default=0,
+                        help='compress for ui_img_rle.c, in independent bands of BAND rows')
+    args = parser.parse_args()
+
+    width, height, rows = bgr_rows(read_c_array(args.input), args.width, args.height)
+    pixels = to_rgb565(rows, args.swap)
+    if args.rle:
+        pixels = rle_encode(pixels, width, height, args.rle)
+
+    with open(args.output, 'w') as f:
+        f.write('/* Generated by gen_lv_img.py from %s, do not edit */\n\n' % args.input.replace('\\', '/').split('/')[-1])
+        f.write('#ifdef LV_LVGL_H_INCLUDE_SIMPLE\n#include "lvgl.h"\n#else\n#include "lvgl/lvgl.h"\n#endif\n\n')
+        f.write('#if LV_COLOR_DEPTH != 16 || LV_COLOR_16_SWAP != %d\n' % (1 if args.swap else 0))
+        f.write('#error "%s was generated for RGB565 with LV_COLOR_16_SWAP=%d"\n#endif\n\n' % (args.name, 1 if args.swap else 0))
+        f.write('#ifndef LV_ATTRIBUTE_MEM_ALIGN\n#define LV_ATTRIBUTE_MEM_ALIGN\n#endif\n\n')
+        f.write('static const LV_ATTRIBUTE_MEM_ALIGN uint8_t %s_map[] = {\n' % args.name)
+        line = width * 2
+        for i in range(0, len(pixels), line):
+            f.write('  ' + ', '.join('0x%02x' % v for v in pixels[i:i + line]) + ',\n')
+        f.write('};\n\n')
+        f.write('const lv_img_dsc_t %s = {\n' % args.name)
+        f.write('  .header.always_zero = 0,\n')
+        f.write('  .header.w = %d,\n' % width)
+        f.write('  .header.h = %d,\n' % height)
+        f.write('  .data_size = %d,\n' % len(pixels))
+        f.write('  .header.cf = %s,\n' % ('LV_IMG_CF_RAW' if args.rle else 'LV_IMG_CF_TRUE_COLOR'))
+        f.write('  .data = %s_map,\n' % args.name)
+        f.write('};\n')
+
+
+if __name__ == '__main__':
+    main()
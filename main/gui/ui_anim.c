@@ -0,0 +1,284 @@
+/*
+ * UI Anim: frame-sequence player that streams RLE frames from a file made by gen_anim.py.
+ */
+
+#include "ui_anim.h"
+
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "ui_img_rle.h"
+#include "audio_mixer.h"
+
+static const char *TAG = "ui_anim";
+
+#define ANIM_MAGIC              (0x314D4E41)    /* "ANM1" */
+#define ANIM_LOADER_PRIORITY    (2)
+#define ANIM_LOADER_CORE        (1)
+
+typedef struct {
+    uint32_t magic;
+    uint16_t w;
+    uint16_t h;
+    uint16_t frames;
+    uint16_t fps;
+    uint32_t max_frame_size;
+} anim_file_header_t;   /* Followed by uint32_t offset[frames + 1] */
+
+/* Frames are numbered by tick since start; the file frame is tick % frames */
+typedef struct {
+    uint32_t gen;
+    uint32_t tick;
+} anim_req_t;
+
+/* One open animation file; a new one per start, so a stopped file can outlive its playback */
+typedef struct {
+    FILE *fp;
+    uint32_t *offset;
+    uint8_t *buf[2];
+    lv_img_dsc_t dsc[2];
+    anim_file_header_t hdr;
+    /* Tick loaded in the back buffer, -1 while loading; written by the loader only */
+    volatile int32_t back_tick;
+    volatile bool failed;
+    uint32_t load_us;
+} anim_file_t;
+
+typedef struct {
+    anim_file_t *file;
+    lv_obj_t *img;
+    lv_timer_t *timer;
+    int front;
+    int32_t shown_tick;
+    bool audio_clock;
+    uint32_t clock_base;
+
+    uint32_t shown;
+    uint32_t skipped;
+} anim_t;
+
+static anim_t s_anim;
+static QueueHandle_t s_req_que = NULL;
+static TaskHandle_t s_loader_task = NULL;
+
+/* Hand-over between the LVGL task and the loader; held only for a few assignments, never across I/O */
+static portMUX_TYPE s_anim_mux = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t s_gen = 0;                  /* Bumped by every start and stop; older requests are dropped */
+static anim_file_t *s_loading = NULL;       /* File the loader is reading from */
+static bool s_loading_retired = false;      /* Stopped while being read; the loader frees it */
+
+static void anim_file_free(anim_file_t *file)
+{
+    if (file->fp) {
+        fclose(file->fp);
+    }
+    heap_caps_free(file->offset);
+    for (int i = 0; i < 2; i++) {
+        heap_caps_free(file->buf[i]);
+    }
+    heap_caps_free(file);
+}
+
+static void anim_loader_task(void *pvParam)
+{
+    (void)pvParam;
+    anim_req_t req;
+
+    while (true) {
+        xQueueReceive(s_req_que, &req, portMAX_DELAY);
+        taskENTER_CRITICAL(&s_anim_mux);
+        anim_file_t *file = (req.gen == s_gen) ? s_anim.file : NULL;
+        s_loading = file;
+        const int back = !s_anim.front;
+        taskEXIT_CRITICAL(&s_anim_mux);
+        if (!file) {
+            continue;
+        }
+
+        /* The front buffer only changes after back_tick is set, so back is stable here */
+        const uint32_t frame = req.tick % file->hdr.frames;
+        const uint32_t size = file->offset[frame + 1] - file->offset[frame];
+        int64_t start = esp_timer_get_time();
+        const bool ok = size <= file->hdr.max_frame_size
+                        && 0 == fseek(file->fp, file->offset[frame], SEEK_SET)
+                        && 1 == fread(file->buf[back], size, 1, file->fp);
+
+        taskENTER_CRITICAL(&s_anim_mux);
+        const bool retired = s_loading_retired;
+        s_loading = NULL;
+        s_loading_retired = false;
+        taskEXIT_CRITICAL(&s_anim_mux);
+        if (retired) {
+            anim_file_free(file);
+        } else if (!ok) {
+            ESP_LOGE(TAG, "read frame %lu failed", (unsigned long)frame);
+            file->failed = true;
+        } else {
+            file->dsc[back].data_size = size;
+            file->load_us += esp_timer_get_time() - start;
+            file->back_tick = req.tick;
+        }
+    }
+}
+
+static void anim_request(uint32_t tick)
+{
+    anim_req_t req = { .gen = s_gen, .tick = tick };
+    xQueueOverwrite(s_req_que, &req);
+}
+
+static uint32_t anim_clock_ms(void)
+{
+    if (s_anim.audio_clock) {
+        return (audio_mixer_stream_played_frames() - s_anim.clock_base) / (AUDIO_MIXER_SAMPLE_RATE / 1000);
+    }
+    return (uint32_t)(esp_timer_get_time() / 1000) - s_anim.clock_base;
+}
+
+static void anim_timer_cb(lv_timer_t *timer)
+{
+    (void)timer;
+    anim_file_t *file = s_anim.file;
+    if (file->failed) {
+        ESP_LOGE(TAG, "animation stopped");
+        ui_anim_stop();
+        return;
+    }
+
+    const int32_t back = file->back_tick;
+    const int32_t due = (uint64_t)anim_clock_ms() * file->hdr.fps / 1000;
+    /* Still loading, or loaded ahead of the clock */
+    if (back < 0 || back > due) {
+        return;
+    }
+
+    s_anim.front = !s_anim.front;
+    /* LVGL caches decoders by source address; this one now holds a different frame */
+    lv_img_cache_invalidate_src(&file->dsc[s_anim.front]);
+    lv_img_set_src(s_anim.img, &file->dsc[s_anim.front]);
+    if (s_anim.shown_tick < 0) {
+        lv_obj_clear_flag(s_anim.img, LV_OBJ_FLAG_HIDDEN);
+    } else if (back > s_anim.shown_tick + 1) {
+        s_anim.skipped += back - s_anim.shown_tick - 1;
+    }
+    s_anim.shown_tick = back;
+    s_anim.shown++;
+
+    /* Frames already due were not loaded in time; skip to the next one */
+    file->back_tick = -1;
+    anim_request(((due > back) ? due : back) + 1);
+}
+
+static esp_err_t anim_open(const char *path, anim_file_t **out)
+{
+    esp_err_t ret = ESP_OK;
+    anim_file_t *file = heap_caps_calloc(1, sizeof(anim_file_t), MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(file, ESP_ERR_NO_MEM, TAG, "no mem for animation");
+    file->back_tick = -1;
+    file->fp = fopen(path, "rb");
+    if (!file->fp) {
+        ESP_LOGW(TAG, "no animation %s", path);
+        heap_caps_free(file);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    anim_file_header_t *hdr = &file->hdr;
+    ESP_GOTO_ON_FALSE(1 == fread(hdr, sizeof(*hdr), 1, file->fp) && ANIM_MAGIC == hdr->magic
+                      && hdr->frames && hdr->fps, ESP_ERR_INVALID_RESPONSE, err, TAG, "%s: bad header", path);
+
+    const size_t table_size = (hdr->frames + 1) * sizeof(uint32_t);
+    file->offset = heap_caps_malloc(table_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ESP_GOTO_ON_FALSE(file->offset, ESP_ERR_NO_MEM, err, TAG, "no mem for frame table");
+    ESP_GOTO_ON_FALSE(1 == fread(file->offset, table_size, 1, file->fp), ESP_ERR_INVALID_SIZE, err, TAG, "%s: read frame table failed", path);
+
+    for (int i = 0; i < 2; i++) {
+        file->buf[i] = heap_caps_malloc(hdr->max_frame_size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+        ESP_GOTO_ON_FALSE(file->buf[i], ESP_ERR_NO_MEM, err, TAG, "no mem for frame buffer");
+        file->dsc[i] = (lv_img_dsc_t) {
+            .header.cf = LV_IMG_CF_RAW,
+            .header.w = hdr->w,
+            .header.h = hdr->h,
+            .data = file->buf[i],
+        };
+    }
+    ESP_LOGI(TAG, "%s: %u frames %ux%u at %u fps, %lu bytes/frame max", path, hdr->frames, hdr->w, hdr->h,
+             hdr->fps, (unsigned long)hdr->max_frame_size);
+    *out = file;
+    return ESP_OK;
+
+err:
+    anim_file_free(file);
+    return ret;
+}
+
+esp_err_t ui_anim_start(lv_obj_t *img, const char *path, bool audio_clock)
+{
+    ESP_RETURN_ON_FALSE(img && path, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+    if (!s_loader_task) {
+        s_req_que = xQueueCreate(1, sizeof(anim_req_t));
+        ESP_RETURN_ON_FALSE(s_req_que, ESP_ERR_NO_MEM, TAG, "Failed create loader queue");
+        BaseType_t ret_val = xTaskCreatePinnedToCore(anim_loader_task, "Anim Loader", 3 * 1024, NULL,
+                             ANIM_LOADER_PRIORITY, &s_loader_task, ANIM_LOADER_CORE);
+        ESP_RETURN_ON_FALSE(pdPASS == ret_val, ESP_FAIL, TAG, "Failed create loader task");
+    }
+    ui_anim_stop();
+
+    anim_file_t *file = NULL;
+    ESP_RETURN_ON_ERROR(anim_open(path, &file), TAG, "open %s failed", path);
+
+    taskENTER_CRITICAL(&s_anim_mux);
+    s_gen++;
+    s_anim.file = file;
+    s_anim.front = 0;
+    taskEXIT_CRITICAL(&s_anim_mux);
+
+    s_anim.img = img;
+    s_anim.shown_tick = -1;
+    s_anim.shown = 0;
+    s_anim.skipped = 0;
+    s_anim.audio_clock = audio_clock;
+    s_anim.clock_base = audio_clock ? audio_mixer_stream_played_frames() : (uint32_t)(esp_timer_get_time() / 1000);
+    lv_obj_add_flag(img, LV_OBJ_FLAG_HIDDEN);
+
+    anim_request(0);
+    s_anim.timer = lv_timer_create(anim_timer_cb, 1000 / file->hdr.fps, NULL);
+    return ESP_OK;
+}
+
+void ui_anim_stop(void)
+{
+    if (!s_anim.timer) {
+        return;
+    }
+    anim_file_t *file = s_anim.file;
+    lv_timer_del(s_anim.timer);
+    s_anim.timer = NULL;
+    lv_obj_add_flag(s_anim.img, LV_OBJ_FLAG_HIDDEN);
+    lv_img_set_src(s_anim.img, NULL);
+    /* A later file may be allocated at the same address; drop the cached decoders now */
+    for (int i = 0; i < 2; i++) {
+        lv_img_cache_invalidate_src(&file->dsc[i]);
+    }
+    ESP_LOGI(TAG, "stop: %lu frames shown, %lu skipped, %lu us avg load", (unsigned long)s_anim.shown,
+             (unsigned long)s_anim.skipped, (unsigned long)(file->load_us / (s_anim.shown ? s_anim.shown : 1)));
+
+    /* Never wait for a read in flight: if the loader has the file, it frees it when done */
+    taskENTER_CRITICAL(&s_anim_mux);
+    s_gen++;
+    s_anim.file = NULL;
+    const bool loading = (s_loading == file);
+    if (loading) {
+        s_loading_retired = true;
+    }
+    taskEXIT_CRITICAL(&s_anim_mux);
+    if (!loading) {
+        anim_file_free(file);
+    }
+}
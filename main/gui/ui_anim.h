@@ -0,0 +1,40 @@
+/*
+ * UI Anim: frame-sequence player that streams RLE frames from a file made by gen_anim.py.
+ *
+ * A loader task reads one compressed frame ahead into a second buffer while LVGL decodes
+ * the current one row by row, so only two compressed frames are ever in memory. A fixed
+ * rate lv_timer picks the frame due on the animation clock; frames the loader could not
+ * deliver in time are skipped rather than slowing the animation down. The sequence loops.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start playing an animation into an image object, replacing the one playing.
+ *
+ * Call with the display lock held. The object is shown when the first frame is loaded.
+ *
+ * @param img Image object to draw into
+ * @param path Animation file
+ * @param audio_clock Follow the audio mixer's stream position, so the animation holds while
+ *                    the song buffers and stays in step with it; otherwise run on wall time
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NOT_FOUND if the file does not exist
+ */
+esp_err_t ui_anim_start(lv_obj_t *img, const char *path, bool audio_clock);
+
+/**
+ * @brief Stop the animation and hide its image object. Call with the display lock held.
+ */
+void ui_anim_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,77 @@
+/*
+ * UI Display Stats: refresh timing and redrawn area, to compare display buffer modes.
+ */
+
+#include "ui_disp_stats.h"
+
+#include <string.h>
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "lvgl.h"
+
+static const char *TAG = "disp_stats";
+
+#ifdef CONFIG_APP_DISPLAY_STATS_PERIOD_MS
+#define DISP_STATS_PERIOD_MS    CONFIG_APP_DISPLAY_STATS_PERIOD_MS
+#else
+#define DISP_STATS_PERIOD_MS    (5000)
+#endif
+
+typedef struct {
+    uint32_t refr;          /*!< Refreshes that redrew something */
+    uint32_t full;          /*!< ... of which covered the whole screen */
+    uint32_t flush;         /*!< Bands sent to the LCD */
+    uint32_t time_ms;       /*!< Render + flush time, summed */
+    uint32_t max_ms;
+    uint64_t px;            /*!< Pixels redrawn, summed */
+} disp_stats_t;
+
+static disp_stats_t s_stats;
+static int64_t s_period_start = 0;
+static void (*s_port_flush_cb)(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map) = NULL;
+
+static void disp_stats_flush(lv_disp_drv_t *drv, const lv_area_t *area, lv_color_t *color_map)
+{
+    s_stats.flush++;
+    s_port_flush_cb(drv, area, color_map);
+}
+
+/* Called by LVGL after every refresh that redrew something */
+static void disp_stats_monitor(lv_disp_drv_t *drv, uint32_t time, uint32_t px)
+{
+    const uint32_t screen_px = drv->hor_res * drv->ver_res;
+    s_stats.refr++;
+    s_stats.full += (px >= screen_px);
+    s_stats.time_ms += time;
+    s_stats.max_ms = (time > s_stats.max_ms) ? time : s_stats.max_ms;
+    s_stats.px += px;
+
+    const int64_t now = esp_timer_get_time();
+    const int64_t elapsed_ms = (now - s_period_start) / 1000;
+    if (elapsed_ms < DISP_STATS_PERIOD_MS) {
+        return;
+    }
+    ESP_LOGI(TAG, "%lu refr in %lld ms: %lu ms avg, %lu ms max, %lu%% of screen redrawn, %lu full, %lu.%lu bands/refr",
+             (unsigned long)s_stats.refr, elapsed_ms,
+             (unsigned long)(s_stats.time_ms / s_stats.refr), (unsigned long)s_stats.max_ms,
+             (unsigned long)(s_stats.px * 100 / ((uint64_t)screen_px * s_stats.refr)), (unsigned long)s_stats.full,
+             (unsigned long)(s_stats.flush / s_stats.refr), (unsigned long)(s_stats.flush * 10 / s_stats.refr % 10));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_period_start = now;
+}
+
+esp_err_t ui_disp_stats_start(void)
+{
+    lv_disp_t *disp = lv_disp_get_default();
+    ESP_RETURN_ON_FALSE(disp && disp->driver->flush_cb, ESP_ERR_INVALID_STATE, TAG, "display not started");
+    ESP_RETURN_ON_FALSE(!s_port_flush_cb, ESP_ERR_INVALID_STATE, TAG, "already started");
+
+    s_port_flush_cb = disp->driver->flush_cb;
+    disp->driver->flush_cb = disp_stats_flush;
+    disp->driver->monitor_cb = disp_stats_monitor;
+    s_period_start = esp_timer_get_time();
+    ESP_LOGI(TAG, "draw buffers: %lu px x %d", (unsigned long)disp->driver->draw_buf->size,
+             disp->driver->draw_buf->buf2 ? 2 : 1);
+    return ESP_OK;
+}
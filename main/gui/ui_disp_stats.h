@@ -0,0 +1,24 @@
+/*
+ * UI Display Stats: refresh timing and redrawn area, to compare display buffer modes.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Hook the default display and log its statistics every CONFIG_APP_DISPLAY_STATS_PERIOD_MS.
+ *
+ * Call with the display lock held, after the display is started.
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t ui_disp_stats_start(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,160 @@
+/*
+ * UI Image Cache: PSRAM residency for the full-screen images, within a byte budget.
+ */
+
+#include "ui_img_cache.h"
+
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "ui_img_rle.h"
+
+static const char *TAG = "ui_img_cache";
+
+/* Flash-resident RLE, see gen_lv_img.py */
+LV_IMG_DECLARE(img_main_face);
+LV_IMG_DECLARE(img_lock);
+LV_IMG_DECLARE(img_unlock);
+LV_IMG_DECLARE(img_dancing);
+LV_IMG_DECLARE(img_story);
+LV_IMG_DECLARE(img_fall_detected);
+
+static const lv_img_dsc_t *const s_source[UI_IMG_MAX] = {
+    [UI_IMG_MAIN_FACE]      = &img_main_face,
+    [UI_IMG_LOCK]           = &img_lock,
+    [UI_IMG_UNLOCK]         = &img_unlock,
+    [UI_IMG_DANCING]        = &img_dancing,
+    [UI_IMG_STORY]          = &img_story,
+    [UI_IMG_FALL_DETECTED]  = &img_fall_detected,
+};
+
+typedef struct {
+    lv_img_dsc_t dsc;       /*!< Handed to LVGL; the decoded `buf`, or a copy of the flash source */
+    uint8_t *buf;           /*!< Resident copy, NULL when drawn from flash */
+    uint32_t last_use;
+    bool pinned;
+} ui_img_entry_t;
+
+static ui_img_entry_t s_entry[UI_IMG_MAX];
+static size_t s_budget = 0;
+static size_t s_used = 0;
+static size_t s_pinned = 0;     /* Part of s_used that can never be evicted */
+static uint32_t s_use_clock = 0;
+static bool s_init = false;
+
+static size_t ui_img_resident_size(ui_img_id_t id)
+{
+    return s_source[id]->header.w * s_source[id]->header.h * sizeof(lv_color_t);
+}
+
+static void ui_img_evict(ui_img_id_t id)
+{
+    ui_img_entry_t *e = &s_entry[id];
+    /* Back to flash first; LVGL reads dsc.data on every draw, so nothing dangles */
+    e->dsc = *s_source[id];
+    lv_img_cache_invalidate_src(&e->dsc);
+    heap_caps_free(e->buf);
+    e->buf = NULL;
+    s_used -= ui_img_resident_size(id);
+    ESP_LOGI(TAG, "evict %d, %u/%u bytes resident", id, (unsigned)s_used, (unsigned)s_budget);
+}
+
+/* Evict least recently used images until `need` more bytes fit; `keep` is never evicted */
+static bool ui_img_make_room(size_t need, ui_img_id_t keep)
+{
+    while (s_used + need > s_budget) {
+        int victim = -1;
+        for (int i = 0; i < UI_IMG_MAX; i++) {
+            const ui_img_entry_t *e = &s_entry[i];
+            if (!e->buf || e->pinned || keep == i) {
+                continue;
+            }
+            if (victim < 0 || e->last_use < s_entry[victim].last_use) {
+                victim = i;
+            }
+        }
+        if (victim < 0) {
+            return false;
+        }
+        ui_img_evict(victim);
+    }
+    return true;
+}
+
+static esp_err_t ui_img_load(ui_img_id_t id)
+{
+    ui_img_entry_t *e = &s_entry[id];
+    if (e->buf) {
+        return ESP_OK;
+    }
+
+    const size_t size = ui_img_resident_size(id);
+    ESP_RETURN_ON_FALSE(ui_img_make_room(size, id), ESP_ERR_NO_MEM, TAG, "image %d does not fit the budget", id);
+
+    int64_t start = esp_timer_get_time();
+    e->buf = heap_caps_malloc(size, MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    ESP_RETURN_ON_FALSE(e->buf, ESP_ERR_NO_MEM, TAG, "no mem for image %d", id);
+    esp_err_t ret = ESP_OK;
+    if (ui_img_rle_check(s_source[id])) {
+        ret = ui_img_rle_decode(s_source[id], (lv_color_t *)e->buf);
+    } else {
+        memcpy(e->buf, s_source[id]->data, size);
+    }
+    if (ESP_OK != ret) {
+        heap_caps_free(e->buf);
+        e->buf = NULL;
+        return ret;
+    }
+
+    e->dsc.header.cf = LV_IMG_CF_TRUE_COLOR;
+    e->dsc.data_size = size;
+    e->dsc.data = e->buf;
+    lv_img_cache_invalidate_src(&e->dsc);
+    s_used += size;
+    ESP_LOGI(TAG, "load %d in %lld us, %u/%u bytes resident", id, esp_timer_get_time() - start,
+             (unsigned)s_used, (unsigned)s_budget);
+    return ESP_OK;
+}
+
+esp_err_t ui_img_cache_init(size_t budget)
+{
+    ESP_RETURN_ON_FALSE(!s_init, ESP_ERR_INVALID_STATE, TAG, "already initialized");
+    /* Images that are not resident are streamed from flash by the RLE decoder */
+    ESP_RETURN_ON_ERROR(ui_img_rle_init(), TAG, "register RLE decoder failed");
+    for (int i = 0; i < UI_IMG_MAX; i++) {
+        s_entry[i].dsc = *s_source[i];
+    }
+    s_budget = budget;
+    s_init = true;
+    return ESP_OK;
+}
+
+const lv_img_dsc_t *ui_img_cache_get(ui_img_id_t id)
+{
+    assert(s_init && id < UI_IMG_MAX);
+    ui_img_entry_t *e = &s_entry[id];
+    e->last_use = ++s_use_clock;
+    if (!e->buf && s_pinned + ui_img_resident_size(id) > s_budget) {
+        /* Cannot be resident even with every other image evicted: stream it, as designed */
+        ESP_LOGD(TAG, "image %d streams from flash", id);
+        return &e->dsc;
+    }
+    if (ESP_OK != ui_img_load(id)) {
+        ESP_LOGW(TAG, "image %d drawn from flash", id);
+    }
+    return &e->dsc;
+}
+
+esp_err_t ui_img_cache_pin(ui_img_id_t id)
+{
+    ESP_RETURN_ON_FALSE(s_init && id < UI_IMG_MAX, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+    ESP_RETURN_ON_ERROR(ui_img_load(id), TAG, "pin %d failed", id);
+    if (!s_entry[id].pinned) {
+        s_entry[id].pinned = true;
+        s_pinned += ui_img_resident_size(id);
+    }
+    return ESP_OK;
+}
@@ -0,0 +1,65 @@
+/*
+ * UI Image Cache: PSRAM residency for the full-screen images, within a byte budget.
+ *
+ * Every image always has a drawable descriptor. It is the flash-resident RLE source,
+ * streamed row by row through the decoder, until the image is made resident; then it
+ * is a decoded RGB565 copy in PSRAM that LVGL blits directly. Images become resident on
+ * first show, the least recently shown ones are evicted back to flash to stay within the
+ * budget, and pinned images are never evicted.
+ *
+ * All functions must be called with the display lock held.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    UI_IMG_MAIN_FACE,
+    UI_IMG_LOCK,
+    UI_IMG_UNLOCK,
+    UI_IMG_DANCING,
+    UI_IMG_STORY,
+    UI_IMG_FALL_DETECTED,
+    UI_IMG_MAX,
+} ui_img_id_t;
+
+/* The pinned fall alert plus the most recently shown screen; raise it to keep more screens decoded */
+#define UI_IMG_CACHE_BUDGET_DEFAULT (2 * 320 * 240 * LV_COLOR_SIZE / 8)
+
+/**
+ * @brief Set up the descriptors and the residency budget.
+ *
+ * @param budget Max bytes of PSRAM held by resident images
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t ui_img_cache_init(size_t budget);
+
+/**
+ * @brief Get an image for lv_img_set_src(), making it resident and most recently used.
+ *
+ * The pointer is stable for the life of the program. An image that cannot fit beside
+ * the pinned ones is drawn from flash, which is expected with a small budget.
+ *
+ * @param id Image to get
+ * @return const lv_img_dsc_t* Descriptor of the image
+ */
+const lv_img_dsc_t *ui_img_cache_get(ui_img_id_t id);
+
+/**
+ * @brief Make an image resident now and never evict it, so its first show is never cold.
+ *
+ * @param id Image to pre-warm
+ * @return esp_err_t ESP_OK on success, ESP_ERR_NO_MEM if it does not fit the budget
+ */
+esp_err_t ui_img_cache_pin(ui_img_id_t id);
+
+#ifdef __cplusplus
+}
+#endif
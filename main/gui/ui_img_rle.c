@@ -0,0 +1,219 @@
+/*
+ * UI Image RLE: run-length compressed RGB565 images and their LVGL decoder.
+ *
+ * Layout written by gen_lv_img.py: ui_img_rle_header_t, one payload offset per band, then
+ * the rows. Each row is a sequence of ops:
+ *   0x00-0x3F  n+1 literal pixels follow
+ *   0x40-0x7F  one pixel follows, repeated n+1 times
+ *   0x80-0xFF  copy n+1 pixels from the row above (never on a band's first row)
+ */
+
+#include "ui_img_rle.h"
+
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_check.h"
+#include "esp_log.h"
+
+static const char *TAG = "ui_img_rle";
+
+#define UI_IMG_RLE_MAGIC    (0x31454C52)    /* "RLE1" */
+
+#if LV_COLOR_DEPTH != 16
+#error "ui_img_rle decodes to RGB565 only"
+#endif
+
+/* Followed by uint32_t band_offset[bands], each from the end of that table */
+typedef struct {
+    uint32_t magic;
+    uint16_t w;
+    uint16_t h;
+    uint16_t band;          /*!< Rows per independently decodable band */
+    uint16_t reserved;
+} ui_img_rle_header_t;
+
+/* Per-open decoder state: the last decoded row and where the next one starts */
+typedef struct {
+    const uint8_t *next;
+    int y;
+    lv_color_t row[];
+} ui_img_rle_ctx_t;
+
+/* The map is a byte array with no alignment guarantee, so the header and offsets are copied out */
+static inline ui_img_rle_header_t rle_header(const lv_img_dsc_t *dsc)
+{
+    ui_img_rle_header_t hdr;
+    memcpy(&hdr, dsc->data, sizeof(hdr));
+    return hdr;
+}
+
+static inline const uint8_t *rle_band_start(const lv_img_dsc_t *dsc, const ui_img_rle_header_t *hdr, int y)
+{
+    const uint32_t bands = (hdr->h + hdr->band - 1) / hdr->band;
+    const uint8_t *table = dsc->data + sizeof(*hdr);
+    uint32_t offset;
+    memcpy(&offset, table + (y / hdr->band) * sizeof(offset), sizeof(offset));
+    return table + bands * sizeof(offset) + offset;
+}
+
+/*
+ * Decode one row into `row`. `above` is the previous row, NULL on a band's first row;
+ * it may be `row` itself, in which case copied pixels are simply left in place.
+ */
+static const uint8_t *rle_decode_row(const uint8_t *p, const uint8_t *end, lv_color_t *row,
+                                     const lv_color_t *above, int w)
+{
+    int x = 0;
+    while (x < w) {
+        if (p >= end) {
+            return NULL;
+        }
+        const uint8_t op = *p++;
+        if (op & 0x80) {
+            int n = (op & 0x7F) + 1;
+            if (!above || x + n > w) {
+                return NULL;
+            }
+            if (above != row) {
+                memcpy(&row[x], &above[x], n * sizeof(lv_color_t));
+            }
+            x += n;
+        } else if (op & 0x40) {
+            int n = (op & 0x3F) + 1;
+            if (x + n > w || p + sizeof(lv_color_t) > end) {
+                return NULL;
+            }
+            lv_color_t c;
+            memcpy(&c, p, sizeof(c));
+            p += sizeof(c);
+            while (n--) {
+                row[x++] = c;
+            }
+        } else {
+            int n = op + 1;
+            if (x + n > w || p + n * sizeof(lv_color_t) > end) {
+                return NULL;
+            }
+            memcpy(&row[x], p, n * sizeof(lv_color_t));
+            p += n * sizeof(lv_color_t);
+            x += n;
+        }
+    }
+    return p;
+}
+
+bool ui_img_rle_check(const lv_img_dsc_t *dsc)
+{
+    if (!dsc || LV_IMG_CF_RAW != dsc->header.cf || dsc->data_size < sizeof(ui_img_rle_header_t)) {
+        return false;
+    }
+    const ui_img_rle_header_t hdr = rle_header(dsc);
+    return UI_IMG_RLE_MAGIC == hdr.magic && hdr.band && hdr.w == dsc->header.w && hdr.h == dsc->header.h
+           && dsc->data_size >= sizeof(hdr) + (hdr.h + hdr.band - 1) / hdr.band * sizeof(uint32_t);
+}
+
+esp_err_t ui_img_rle_decode(const lv_img_dsc_t *dsc, lv_color_t *dst)
+{
+    ESP_RETURN_ON_FALSE(ui_img_rle_check(dsc) && dst, ESP_ERR_INVALID_ARG, TAG, "invalid arg");
+    const ui_img_rle_header_t hdr = rle_header(dsc);
+    const uint8_t *end = dsc->data + dsc->data_size;
+    const uint8_t *p = NULL;
+
+    for (int y = 0; y < hdr.h; y++) {
+        lv_color_t *row = dst + y * hdr.w;
+        const bool first = (0 == y % hdr.band);
+        if (first) {
+            p = rle_band_start(dsc, &hdr, y);
+        }
+        p = rle_decode_row(p, end, row, first ? NULL : row - hdr.w, hdr.w);
+        ESP_RETURN_ON_FALSE(p, ESP_ERR_INVALID_RESPONSE, TAG, "corrupt row %d", y);
+    }
+    return ESP_OK;
+}
+
+static lv_res_t rle_info(lv_img_decoder_t *decoder, const void *src, lv_img_header_t *header)
+{
+    LV_UNUSED(decoder);
+    if (LV_IMG_SRC_VARIABLE != lv_img_src_get_type(src) || !ui_img_rle_check(src)) {
+        return LV_RES_INV;
+    }
+    const lv_img_dsc_t *dsc = src;
+    header->always_zero = 0;
+    header->w = dsc->header.w;
+    header->h = dsc->header.h;
+    header->cf = LV_IMG_CF_TRUE_COLOR;
+    return LV_RES_OK;
+}
+
+static lv_res_t rle_open(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    LV_UNUSED(decoder);
+    if (LV_IMG_SRC_VARIABLE != dsc->src_type || !ui_img_rle_check(dsc->src)) {
+        return LV_RES_INV;
+    }
+    const ui_img_rle_header_t hdr = rle_header(dsc->src);
+    ui_img_rle_ctx_t *ctx = heap_caps_malloc(sizeof(ui_img_rle_ctx_t) + hdr.w * sizeof(lv_color_t),
+                            MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (!ctx) {
+        ESP_LOGE(TAG, "no mem for decoder row");
+        return LV_RES_INV;
+    }
+    ctx->next = NULL;
+    ctx->y = -1;
+    dsc->user_data = ctx;
+    /* No img_data: LVGL pulls the image row by row through rle_read_line() */
+    dsc->img_data = NULL;
+    return LV_RES_OK;
+}
+
+static lv_res_t rle_read_line(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc,
+                              lv_coord_t x, lv_coord_t y, lv_coord_t len, uint8_t *buf)
+{
+    LV_UNUSED(decoder);
+    const lv_img_dsc_t *img = dsc->src;
+    const ui_img_rle_header_t hdr = rle_header(img);
+    ui_img_rle_ctx_t *ctx = dsc->user_data;
+
+    if (y != ctx->y) {
+        /* LVGL draws top down, so this is normally just the next row of the band */
+        int row = y;
+        if (y != ctx->y + 1 || 0 == y % hdr.band) {
+            row = y - y % hdr.band;
+            ctx->next = rle_band_start(img, &hdr, row);
+        }
+        const uint8_t *end = img->data + img->data_size;
+        for (; row <= y; row++) {
+            ctx->next = rle_decode_row(ctx->next, end, ctx->row, (row % hdr.band) ? ctx->row : NULL, hdr.w);
+            if (!ctx->next) {
+                ESP_LOGE(TAG, "corrupt row %d", row);
+                ctx->y = -1;
+                return LV_RES_INV;
+            }
+        }
+        ctx->y = y;
+    }
+    memcpy(buf, &ctx->row[x], len * sizeof(lv_color_t));
+    return LV_RES_OK;
+}
+
+static void rle_close(lv_img_decoder_t *decoder, lv_img_decoder_dsc_t *dsc)
+{
+    LV_UNUSED(decoder);
+    heap_caps_free(dsc->user_data);
+    dsc->user_data = NULL;
+}
+
+esp_err_t ui_img_rle_init(void)
+{
+    static lv_img_decoder_t *s_decoder = NULL;
+    if (s_decoder) {
+        return ESP_OK;
+    }
+    s_decoder = lv_img_decoder_create();
+    ESP_RETURN_ON_FALSE(s_decoder, ESP_ERR_NO_MEM, TAG, "create decoder failed");
+    lv_img_decoder_set_info_cb(s_decoder, rle_info);
+    lv_img_decoder_set_open_cb(s_decoder, rle_open);
+    lv_img_decoder_set_read_line_cb(s_decoder, rle_read_line);
+    lv_img_decoder_set_close_cb(s_decoder, rle_close);
+    return ESP_OK;
+}
@@ -0,0 +1,42 @@
+/*
+ * UI Image RLE: run-length compressed RGB565 images and their LVGL decoder.
+ *
+ * Images produced by `gen_lv_img.py --rle` are LV_IMG_CF_RAW descriptors. They are split
+ * into bands of rows that decode independently, so the decoder streams one row at a time
+ * into LVGL's draw buffer and never needs more than a row of RAM.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Register the LVGL image decoder. Call with the display lock held.
+ *
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t ui_img_rle_init(void);
+
+/**
+ * @brief Whether a descriptor holds an RLE image.
+ */
+bool ui_img_rle_check(const lv_img_dsc_t *dsc);
+
+/**
+ * @brief Decode a whole RLE image.
+ *
+ * @param dsc RLE image
+ * @param dst header.w * header.h pixels
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t ui_img_rle_decode(const lv_img_dsc_t *dsc, lv_color_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
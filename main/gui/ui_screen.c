@@ -0,0 +1,88 @@
+/*
+ * UI Screen: one LVGL screen per mode, so only the active mode is in the render tree.
+ */
+
+#include "ui_screen.h"
+
+#include "esp_check.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+static const char *TAG = "ui_screen";
+
+typedef struct {
+    const char *name;
+    uint8_t priority;       /*!< A screen is only replaced by one of equal or higher priority */
+} ui_screen_info_t;
+
+static const ui_screen_info_t s_info[UI_SCREEN_MAX] = {
+    [UI_SCREEN_MAIN]    = { "main",  0 },
+    [UI_SCREEN_DOOR]    = { "door",  0 },
+    [UI_SCREEN_DANCE]   = { "dance", 0 },
+    [UI_SCREEN_STORY]   = { "story", 0 },
+    [UI_SCREEN_FALL]    = { "fall",  1 },
+};
+
+static lv_obj_t *s_screen[UI_SCREEN_MAX];
+static ui_screen_id_t s_current = UI_SCREEN_MAX;
+/* Last requested base screen, shown again when a priority screen closes */
+static ui_screen_id_t s_resume = UI_SCREEN_MAIN;
+
+static esp_err_t ui_screen_load(ui_screen_id_t id)
+{
+    ESP_RETURN_ON_FALSE(s_screen[id], ESP_ERR_INVALID_STATE, TAG, "%s not created", s_info[id].name);
+    if (id == s_current) {
+        return ESP_OK;
+    }
+
+    int64_t start = esp_timer_get_time();
+    /* The boot screen is not ours, drop it on the first load */
+    lv_scr_load_anim(s_screen[id], LV_SCR_LOAD_ANIM_NONE, 0, 0, UI_SCREEN_MAX == s_current);
+    /* The LVGL task draws the new screen on its next period, so callers do not hold the display
+     * lock through a full frame; only a priority screen (the fall alert) is rendered right away */
+    if (s_info[id].priority) {
+        lv_refr_now(NULL);
+    }
+    ESP_LOGI(TAG, "%s -> %s in %lld us", (UI_SCREEN_MAX == s_current) ? "boot" : s_info[s_current].name,
+             s_info[id].name, esp_timer_get_time() - start);
+    s_current = id;
+    return ESP_OK;
+}
+
+lv_obj_t *ui_screen_create(ui_screen_id_t id)
+{
+    ESP_RETURN_ON_FALSE(id < UI_SCREEN_MAX && !s_screen[id], NULL, TAG, "invalid screen %d", id);
+    lv_obj_t *scr = lv_obj_create(NULL);
+    ESP_RETURN_ON_FALSE(scr, NULL, TAG, "create %s failed", s_info[id].name);
+    lv_obj_clear_flag(scr, LV_OBJ_FLAG_SCROLLABLE);
+    lv_obj_set_style_pad_all(scr, 0, LV_PART_MAIN);
+    s_screen[id] = scr;
+    return scr;
+}
+
+esp_err_t ui_screen_show(ui_screen_id_t id)
+{
+    ESP_RETURN_ON_FALSE(id < UI_SCREEN_MAX, ESP_ERR_INVALID_ARG, TAG, "invalid screen %d", id);
+    if (0 == s_info[id].priority) {
+        s_resume = id;
+    }
+    if (s_current < UI_SCREEN_MAX && s_info[id].priority < s_info[s_current].priority) {
+        ESP_LOGI(TAG, "%s deferred behind %s", s_info[id].name, s_info[s_current].name);
+        return ESP_OK;
+    }
+    return ui_screen_load(id);
+}
+
+esp_err_t ui_screen_close(ui_screen_id_t id)
+{
+    ESP_RETURN_ON_FALSE(id < UI_SCREEN_MAX, ESP_ERR_INVALID_ARG, TAG, "invalid screen %d", id);
+    if (id != s_current || 0 == s_info[id].priority) {
+        return ESP_OK;
+    }
+    return ui_screen_load(s_resume);
+}
+
+ui_screen_id_t ui_screen_current(void)
+{
+    return s_current;
+}
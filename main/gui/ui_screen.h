@@ -0,0 +1,61 @@
+/*
+ * UI Screen: one LVGL screen per mode, so only the active mode is in the render tree.
+ *
+ * Showing a screen is the only transition; there is no "hide", the next show replaces it.
+ * Screens have a priority: while a higher priority screen (the fall alert) is up, lower
+ * priority requests are only remembered, and closing it returns to the last one.
+ *
+ * All functions must be called with the display lock held.
+ */
+
+#pragma once
+
+#include "esp_err.h"
+#include "lvgl.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    UI_SCREEN_MAIN,
+    UI_SCREEN_DOOR,
+    UI_SCREEN_DANCE,
+    UI_SCREEN_STORY,
+    UI_SCREEN_FALL,
+    UI_SCREEN_MAX,
+} ui_screen_id_t;
+
+/**
+ * @brief Create the screen object of a mode; the caller builds its content on it.
+ *
+ * @param id Screen to create
+ * @return lv_obj_t* The screen, NULL on failure
+ */
+lv_obj_t *ui_screen_create(ui_screen_id_t id);
+
+/**
+ * @brief Request a screen. It is loaded right away unless a higher priority screen is up; the LVGL
+ *        task draws it, except a priority screen, which is rendered before this returns.
+ *
+ * @param id Screen to show
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t ui_screen_show(ui_screen_id_t id);
+
+/**
+ * @brief Close a priority screen and return to the last requested one. No-op for other screens.
+ *
+ * @param id Screen to close
+ * @return esp_err_t ESP_OK on success
+ */
+esp_err_t ui_screen_close(ui_screen_id_t id);
+
+/**
+ * @brief The screen currently loaded.
+ */
+ui_screen_id_t ui_screen_current(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -4,7 +4,9 @@
  * SPDX-License-Identifier: Unlicense OR CC0-1.0
  */
 
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 
@@ -16,6 +18,8 @@
 #include "main_ui.h"
 #include "gui/ui_boot_animate.h"
 #include "gui/ui_sr.h"
+#include "gui/ui_img_cache.h"
+#include "gui/ui_disp_stats.h"
 
 #include "door_ui.h"
 #include "dance_ui.h"
@@ -25,11 +29,85 @@
 #include "app/app_audio.h"
 #include "app/app_uart.h"
 #include "app/app_espnow.h"
+#include "app/audio_mixer.h"
+
+#define PAIR_FORGET_WINDOW_US   (10 * 1000 * 1000)  /* Double click after the long press to forget */
+#define FORGET_TASK_STACK       (4096)
 
 static const char *TAG = "main";
+static int64_t s_pair_btn_us = 0;
+
+/* One NVS write per node, too much for the esp_timer task the button callbacks run in */
+static void forget_nodes_task(void *arg)
+{
+    app_espnow_peer_info_t info;
+    int n = 0;
+    for (int i = 0; i < APP_ESPNOW_PEER_MAX; i++) {
+        if (ESP_OK == app_espnow_get_peer(i, &info) && ESP_OK == app_espnow_unpair(info.mac)) {
+            n++;
+        }
+    }
+    ESP_LOGW(TAG, "Forgot %d nodes; each pairs again after \"unpair\" on its serial monitor", n);
+    vTaskDelete(NULL);
+}
+
+/* BOOT held: let nodes pair. A double click within 10 s of that forgets every paired node */
+static void pair_btn_handler(void *handle, void *arg)
+{
+    const int64_t now = esp_timer_get_time();
+    if (BUTTON_LONG_PRESS_START == (button_event_t)arg) {
+        s_pair_btn_us = now;
+        app_espnow_pair_start(APP_ESPNOW_PAIR_WINDOW_MS);
+    } else if (s_pair_btn_us && now - s_pair_btn_us < PAIR_FORGET_WINDOW_US) {
+        s_pair_btn_us = 0;
+        if (pdPASS != xTaskCreate(forget_nodes_task, "forget_nodes", FORGET_TASK_STACK, NULL, 1, NULL)) {
+            ESP_LOGE(TAG, "forget nodes: no memory for the task");
+        }
+    }
+}
+
+static void display_start(void)
+{
+    bsp_display_cfg_t cfg = {
+        .lvgl_port_cfg = ESP_LVGL_PORT_INIT_CONFIG(),
+        .buffer_size = BSP_LCD_H_RES * CONFIG_BSP_LCD_DRAW_BUF_HEIGHT,
+        .double_buffer = 0,
+        .flags = {
+            .buff_dma = true,
+        }
+    };
+    cfg.lvgl_port_cfg.task_affinity = 1;
+
+#if CONFIG_APP_DISPLAY_BUFFER_FULL_FRAME
+    /* Whole screen rendered in one pass while the previous frame is still flushing */
+    const size_t frame = BSP_LCD_H_RES * BSP_LCD_V_RES * sizeof(lv_color_t);
+    if (heap_caps_get_largest_free_block(MALLOC_CAP_SPIRAM) >= 2 * frame) {
+        cfg.buffer_size = BSP_LCD_H_RES * BSP_LCD_V_RES;
+        cfg.flags.buff_dma = false;
+        cfg.flags.buff_spiram = true;
+    } else {
+        ESP_LOGW(TAG, "not enough PSRAM for two frames, using two DMA bands");
+    }
+    cfg.double_buffer = 1;
+#elif CONFIG_APP_DISPLAY_BUFFER_DOUBLE_BAND
+    /* Render the next band while the previous one is flushing */
+    cfg.double_buffer = 1;
+#endif
+    bsp_display_start_with_config(&cfg);
+
+#if CONFIG_APP_DISPLAY_STATS
+    bsp_display_lock(0);
+    ESP_ERROR_CHECK(ui_disp_stats_start());
+    bsp_display_unlock();
+#endif
+}
 
 static void after_boot(void)
 {
+    /* Full-screen images stream from flash through the RLE decoder; the fall alert is pre-warmed */
+    ESP_ERROR_CHECK(ui_img_cache_init(UI_IMG_CACHE_BUDGET_DEFAULT));
+    ESP_ERROR_CHECK(ui_img_cache_pin(UI_IMG_FALL_DETECTED));
+
     /* Minimal main screen + SR overlay */
     ESP_ERROR_CHECK(main_ui_start());
     ESP_ERROR_CHECK(door_ui_start());
@@ -60,17 +138,12 @@ void app_main(void)
 
     bsp_i2c_init();
 
-    bsp_display_cfg_t cfg = {
-        .lvgl_port_cfg = ESP_LVGL_PORT_INIT_CONFIG(),
-        .buffer_size = BSP_LCD_H_RES * CONFIG_BSP_LCD_DRAW_BUF_HEIGHT,
-        .double_buffer = 0,
-        .flags = {
-            .buff_dma = true,
-        }
-    };
-    cfg.lvgl_port_cfg.task_affinity = 1;
-    bsp_display_start_with_config(&cfg);
+    display_start();
     bsp_board_init();
+    ESP_ERROR_CHECK(bsp_btn_register_callback(BSP_BUTTON_CONFIG, BUTTON_LONG_PRESS_START, pair_btn_handler, (void *)BUTTON_LONG_PRESS_START));
+    ESP_ERROR_CHECK(bsp_btn_register_callback(BSP_BUTTON_CONFIG, BUTTON_DOUBLE_CLICK, pair_btn_handler, (void *)BUTTON_DOUBLE_CLICK));
+    /* Speaker owner; started before SR so the first earcon is not lost */
+    ESP_ERROR_CHECK(audio_mixer_start());
 
     ESP_LOGI(TAG, "start main UI");
     bsp_display_lock(0);